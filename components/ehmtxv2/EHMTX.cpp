@@ -26,17 +26,24 @@ namespace esphome
 
     for (uint8_t i = 0; i < MAXQUEUE; i++)
     {
-      this->queue[i] = new EHMTX_queue(this);
+      this->queue[i] = new EHMTX_queue(this, i);
     }
     ESP_LOGD(TAG, "Constructor finish");
   }
 
   void EHMTX::show_rindicator(int r, int g, int b, int size)
   {
+    if (this->post(&EHMTX::show_rindicator, r, g, b, size))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "show_rindicator");
+    timer.trace(r, g, b, size);
     if (size > 0)
     {
       this->rindicator_color = Color((uint8_t)r & 248, (uint8_t)g & 252, (uint8_t)b & 248);
       this->display_rindicator = size & 3;
+      this->layer_changed(LAYER_RINDICATOR);
       ESP_LOGD(TAG, "show rindicator size: %d r: %d g: %d b: %d", size, r, g, b);
     }
     else
@@ -47,10 +54,17 @@ namespace esphome
 
   void EHMTX::show_lindicator(int r, int g, int b, int size)
   {
+    if (this->post(&EHMTX::show_lindicator, r, g, b, size))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "show_lindicator");
+    timer.trace(r, g, b, size);
     if (size > 0)
     {
       this->lindicator_color = Color((uint8_t)r & 248, (uint8_t)g & 252, (uint8_t)b & 248);
       this->display_lindicator = size & 3;
+      this->layer_changed(LAYER_LINDICATOR);
       ESP_LOGD(TAG, "show lindicator size: %d r: %d g: %d b: %d", size, r, g, b);
     }
     else
@@ -61,36 +75,74 @@ namespace esphome
 
   void EHMTX::hide_rindicator()
   {
+    if (this->post(&EHMTX::hide_rindicator))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "hide_rindicator");
+    timer.trace();
     this->display_rindicator = 0;
+    this->layer_changed(LAYER_RINDICATOR);
     ESP_LOGD(TAG, "hide rindicator");
   }
 
   void EHMTX::hide_lindicator()
   {
+    if (this->post(&EHMTX::hide_lindicator))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "hide_lindicator");
+    timer.trace();
     this->display_lindicator = 0;
+    this->layer_changed(LAYER_LINDICATOR);
     ESP_LOGD(TAG, "hide lindicator");
   }
 
   void EHMTX::set_display_off()
   {
+    if (this->post(&EHMTX::set_display_off))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "set_display_off");
+    timer.trace();
     this->show_display = false;
     ESP_LOGD(TAG, "display off");
   }
 
   void EHMTX::set_display_on()
   {
+    if (this->post(&EHMTX::set_display_on))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "set_display_on");
+    timer.trace();
     this->show_display = true;
     ESP_LOGD(TAG, "display on");
   }
 
   void EHMTX::set_today_color(int r, int g, int b)
   {
+    if (this->post(&EHMTX::set_today_color, r, g, b))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "set_today_color");
+    timer.trace(r, g, b);
     this->today_color = Color((uint8_t)r & 248, (uint8_t)g & 252, (uint8_t)b & 248);
     ESP_LOGD(TAG, "default today color r: %d g: %d b: %d", r, g, b);
   }
 
   void EHMTX::set_weekday_color(int r, int g, int b)
   {
+    if (this->post(&EHMTX::set_weekday_color, r, g, b))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "set_weekday_color");
+    timer.trace(r, g, b);
     this->weekday_color = Color((uint8_t)r & 248, (uint8_t)g & 252, (uint8_t)b & 248);
     ESP_LOGD(TAG, "default weekday color: %d g: %d b: %d", r, g, b);
   }
@@ -107,110 +159,96 @@ namespace esphome
     }
   }
 
-#ifndef USE_ESP8266
-  void EHMTX::bitmap_screen(std::string text, int lifetime, int screen_time)
+  // [rgb565, ...] is read straight into the buffer without a JSON document, returns the number of pixels
+  static uint16_t read_rgb565(const std::string &text, uint16_t *pixels, uint16_t size)
   {
-    ESP_LOGD(TAG, "bitmap screen: lifetime: %d screen_time: %d", lifetime, screen_time);
-    const size_t CAPACITY = JSON_ARRAY_SIZE(256);
-    StaticJsonDocument<CAPACITY> doc;
-    deserializeJson(doc, text);
-    JsonArray array = doc.as<JsonArray>();
-    // extract the values
-    uint16_t i = 0;
-    for (JsonVariant v : array)
-    {
-      uint16_t buf = v.as<int>();
-
-      unsigned char b = (((buf)&0x001F) << 3);
-      unsigned char g = (((buf)&0x07E0) >> 3); // Fixed: shift >> 5 and << 2
-      unsigned char r = (((buf)&0xF800) >> 8); // shift >> 11 and << 3
-      Color c = Color(r, g, b);
+    uint16_t count = 0;
+    const char *p = text.c_str();
+    while ((*p != '\0') && (*p != ']') && (count < size))
+    {
+      if (isdigit(*p) || (*p == '-'))
+      {
+        char *end;
+        pixels[count++] = (uint16_t)strtol(p, &end, 10);
+        p = end;
+      }
+      else
+      {
+        p++;
+      }
+    }
+    return count;
+  }
 
-      this->bitmap[i++] = c;
+  void EHMTX::bitmap_screen(std::string text, int lifetime, int screen_time)
+  {
+    if (this->post(&EHMTX::bitmap_screen, std::move(text), lifetime, screen_time))
+    {
+      return;
     }
+    EHMTX_ServiceTimer timer(this, "bitmap_screen");
+    timer.trace(text, lifetime, screen_time);
+    ESP_LOGD(TAG, "bitmap screen: lifetime: %d screen_time: %d", lifetime, screen_time);
+    read_rgb565(text, this->bitmap, MATRIX_PIXELS);
 
     EHMTX_queue *screen = this->find_free_queue_element();
 
     screen->text = "";
-    screen->endtime = this->clock->now().timestamp + lifetime * 60;
+    screen->endtime = this->uptime() + lifetime * 60;
     screen->mode = MODE_BITMAP_SCREEN;
-    screen->screen_time_ = screen_time;
-    for (auto *t : on_add_screen_triggers_)
-    {
-      t->process("bitmap", (uint8_t)screen->mode);
-    }
-    screen->status();
+    screen->prepare(screen_time);
+    this->queue_event(EVENT_ADD_SCREEN, "bitmap", "", screen->mode);
+    screen->diag(DIAG_SCREEN_ADDED);
   }
 
   void EHMTX::bitmap_small(std::string icon, std::string text, int lifetime, int screen_time, bool default_font, int r, int g, int b)
   {
-    ESP_LOGD(TAG, "small bitmap screen: text: %s lifetime: %d screen_time: %d", text.c_str(), lifetime, screen_time);
-    const size_t CAPACITY = JSON_ARRAY_SIZE(64);
-    StaticJsonDocument<CAPACITY> doc;
-    deserializeJson(doc, icon);
-    JsonArray array = doc.as<JsonArray>();
-    // extract the values
-    uint16_t i = 0;
-    for (JsonVariant v : array)
-    {
-      uint16_t buf = v.as<int>();
-
-      unsigned char b = (((buf)&0x001F) << 3);
-      unsigned char g = (((buf)&0x07E0) >> 3); // Fixed: shift >> 5 and << 2
-      unsigned char r = (((buf)&0xF800) >> 8); // shift >> 11 and << 3
-      Color c = Color(r, g, b);
-
-      this->sbitmap[i++] = c;
+    if (this->post(&EHMTX::bitmap_small, std::move(icon), std::move(text), lifetime, screen_time, default_font, r, g, b))
+    {
+      return;
     }
+    EHMTX_ServiceTimer timer(this, "bitmap_small");
+    timer.trace(icon, text, lifetime, screen_time, default_font, r, g, b);
+    ESP_LOGD(TAG, "small bitmap screen: text: %s lifetime: %d screen_time: %d", text.c_str(), lifetime, screen_time);
+    read_rgb565(icon, this->sbitmap, 64);
 
     EHMTX_queue *screen = this->find_free_queue_element();
 
-    screen->text = text;
+    screen->text = std::move(text);
     screen->text_color = Color(r, g, b);
-    screen->endtime = this->clock->now().timestamp + lifetime * 60;
+    screen->endtime = this->uptime() + lifetime * 60;
     screen->mode = MODE_BITMAP_SMALL;
     screen->default_font = default_font;
-    screen->calc_scroll_time(text, screen_time);
-    for (auto *t : on_add_screen_triggers_)
-    {
-      t->process("bitmap small", (uint8_t)screen->mode);
-    }
-    screen->status();
+    screen->prepare(screen_time);
+    this->queue_event(EVENT_ADD_SCREEN, "bitmap small", "", screen->mode);
+    screen->diag(DIAG_SCREEN_ADDED);
   }
-#endif
-#ifdef USE_ESP8266
-  void EHMTX::bitmap_screen(std::string text, int lifetime, int screen_time)
-  {
-    ESP_LOGW(TAG, "bitmap_screen is not available on ESP8266");
-  }
-  void EHMTX::bitmap_small(std::string i, std::string t, int l, int s, bool f, int r, int g, int b)
-  {
-    ESP_LOGW(TAG, "bitmap_screen is not available on ESP8266");
-  }
-#endif
 
-  uint8_t EHMTX::find_icon(std::string name)
+  // warn false where a missing icon is expected, SCREEN_NAMED screens and markup tags
+  uint8_t EHMTX::find_icon(const std::string &name, bool warn)
   {
     for (uint8_t i = 0; i < this->icon_count; i++)
     {
       if (strcmp(this->icons[i]->name.c_str(), name.c_str()) == 0)
       {
-        ESP_LOGD(TAG, "icon: %s found id: %d", name.c_str(), i);
+        this->diag(DIAG_ICON_FOUND, MAXQUEUE, MODE_EMPTY, i);
         return i;
       }
     }
-    ESP_LOGW(TAG, "icon: %s not found", name.c_str());
-
+    if (warn)
+    {
+      ESP_LOGW(TAG, "icon: %s not found", name.c_str());
+    }
     return MAXICONS;
   }
 
-  uint8_t EHMTX::find_icon_in_queue(std::string name)
+  uint8_t EHMTX::find_icon_in_queue(const std::string &name)
   {
     for (uint8_t i = 0; i < MAXQUEUE; i++)
     {
       if (strcmp(this->queue[i]->icon_name.c_str(), name.c_str()) == 0)
       {
-        ESP_LOGD(TAG, "find icon in queue: icon: %s at position %d", name.c_str(), i);
+        this->diag(DIAG_ICON_IN_QUEUE, i, this->queue[i]->mode, this->queue[i]->icon);
         return i;
       }
     }
@@ -220,34 +258,47 @@ namespace esphome
 
   void EHMTX::hide_gauge()
   {
+    if (this->post(&EHMTX::hide_gauge))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "hide_gauge");
+    timer.trace();
     this->display_gauge = false;
+    this->layer_changed(LAYER_GAUGE);
     ESP_LOGD(TAG, "hide gauge");
   }
 
-#ifndef USE_ESP8266
   void EHMTX::color_gauge(std::string text)
   {
+    if (this->post(&EHMTX::color_gauge, std::move(text)))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "color_gauge");
+    timer.trace(text);
     ESP_LOGD(TAG, "color_gauge: %s", text.c_str());
-    const size_t CAPACITY = JSON_ARRAY_SIZE(8);
-    StaticJsonDocument<CAPACITY> doc;
-    deserializeJson(doc, text);
-    JsonArray array = doc.as<JsonArray>();
-    uint8_t i = 0;
-    for (JsonVariant v : array)
-    {
-      uint16_t buf = v.as<int>();
-
-      unsigned char b = (((buf)&0x001F) << 3);
-      unsigned char g = (((buf)&0x07E0) >> 3); // Fixed: shift >> 5 and << 2
-      unsigned char r = (((buf)&0xF800) >> 8); // shift >> 11 and << 3
-      Color c = Color(r, g, b);
-      this->cgauge[i++] = c;
+    uint16_t pixels[8];
+    uint16_t count = read_rgb565(text, pixels, 8);
+    for (uint16_t i = 0; i < count; i++)
+    {
+      this->cgauge[i] = rgb565_color(pixels[i]);
+    }
+    if (count > 0)
+    {
       this->display_gauge = true;
     }
+    this->layer_changed(LAYER_GAUGE);
   }
 
   void EHMTX::show_gauge(int percent, int r, int g, int b, int bg_r, int bg_g, int bg_b)
   {
+    if (this->post(&EHMTX::show_gauge, percent, r, g, b, bg_r, bg_g, bg_b))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "show_gauge");
+    timer.trace(percent, r, g, b, bg_r, bg_g, bg_b);
     if (percent <= 100)
     {
       Color c = Color(r, g, b);
@@ -264,50 +315,26 @@ namespace esphome
         }
       }
       this->display_gauge = true;
+      this->layer_changed(LAYER_GAUGE);
       ESP_LOGD(TAG, "show_gauge 2 color %d", percent);
     }
   }
-#else
-  void EHMTX::show_gauge(int percent, int r, int g, int b, int bg_r, int bg_g, int bg_b)
-  {
-    this->display_gauge = false;
-    if (percent <= 100)
-    {
-      this->gauge_color = Color(r, g, b);
-      this->gauge_bgcolor = Color(bg_r, bg_g, bg_b);
-      this->display_gauge = true;
-      this->gauge_value = (uint8_t)(100 - percent) * 7 / 100;
-    }
-    ESP_LOGD(TAG, "show_gauge 2 color %d", percent);
-  }
-#endif
 
-#ifdef USE_ESP8266
-  void EHMTX::draw_gauge()
+  void EHMTX::setup()
   {
-    if (this->display_gauge)
+    ESP_LOGD(TAG, "Baking font atlas");
+    this->default_atlas = new EHMTX_FontAtlas();
+    this->default_atlas->bake(this->default_font, EHMTXv2_DEFAULT_FONT_OFFSET_Y);
+    if ((this->special_font == this->default_font) && (EHMTXv2_SPECIAL_FONT_OFFSET_Y == EHMTXv2_DEFAULT_FONT_OFFSET_Y))
     {
-      this->display->line(0, 7, 0, 0, this->gauge_bgcolor);
-      this->display->line(1, 7, 1, 0, esphome::display::COLOR_OFF);
-      this->display->line(0, 7, 0, this->gauge_value, this->gauge_color);
+      this->special_atlas = this->default_atlas;
     }
-  }
-#else
-  void EHMTX::draw_gauge()
-  {
-    if (this->display_gauge)
+    else
     {
-      for (uint8_t y = 0; y < 8; y++)
-      {
-        this->display->draw_pixel_at(0, y, this->cgauge[y]);
-      }
-      this->display->line(1, 7, 1, 0, esphome::display::COLOR_OFF);
+      this->special_atlas = new EHMTX_FontAtlas();
+      this->special_atlas->bake(this->special_font, EHMTXv2_SPECIAL_FONT_OFFSET_Y);
     }
-  }
-#endif
 
-  void EHMTX::setup()
-  {
     ESP_LOGD(TAG, "Setting up services");
     register_service(&EHMTX::get_status, "get_status");
     register_service(&EHMTX::set_display_on, "display_on");
@@ -335,6 +362,12 @@ namespace esphome
 
     register_service(&EHMTX::text_screen, "text_screen", {"text", "lifetime", "screen_time", "default_font", "r", "g", "b"});
     register_service(&EHMTX::rainbow_text_screen, "rainbow_text_screen", {"text", "lifetime", "screen_time", "default_font"});
+    register_service(&EHMTX::ticker_screen, "ticker_screen", {"text", "lifetime", "screen_time", "default_font", "r", "g", "b"});
+    register_service(&EHMTX::ticker_append, "ticker_append", {"text"});
+    register_service(&EHMTX::graph_screen, "graph_screen", {"name", "lifetime", "screen_time", "line", "r", "g", "b"});
+    register_service(&EHMTX::graph_append, "graph_append", {"name", "value"});
+    register_service(&EHMTX::timer_screen, "timer_screen", {"icon_name", "seconds", "lifetime", "screen_time", "default_font", "r", "g", "b"});
+    register_service(&EHMTX::timer_until, "timer_until", {"icon_name", "timestamp", "lifetime", "screen_time", "default_font", "r", "g", "b"});
 
     register_service(&EHMTX::clock_screen, "clock_screen", {"lifetime", "screen_time", "default_font", "r", "g", "b"});
 
@@ -346,25 +379,44 @@ namespace esphome
     register_service(&EHMTX::blank_screen, "blank_screen", {"lifetime", "screen_time"});
 
     register_service(&EHMTX::set_brightness, "brightness", {"value"});
-#ifndef USE_ESP8266
-  #ifdef EHMTXv2_BOOTLOGO
+#ifdef EHMTXv2_TRACE_SIZE
+    register_service(&EHMTX::dump_trace, "dump_trace");
+    register_service(&EHMTX::clear_trace, "clear_trace");
+#endif
+#ifdef EHMTXv2_DIAG_SIZE
+    register_service(&EHMTX::dump_diag, "dump_diag");
+    register_service(&EHMTX::clear_diag, "clear_diag");
+#endif
+#ifdef EHMTXv2_BOOTLOGO
     register_service(&EHMTX::display_boot_logo, "display_boot_logo");
     register_service(&EHMTX::display_version, "display_version");
-  #endif
+#endif
     register_service(&EHMTX::color_gauge, "color_gauge", {"colors"});
     register_service(&EHMTX::bitmap_screen, "bitmap_screen", {"icon", "lifetime", "screen_time"});
     register_service(&EHMTX::bitmap_small, "bitmap_small", {"icon", "text", "lifetime", "screen_time", "default_font", "r", "g", "b"});
-#endif
 
+#ifdef EHMTXv2_PERSIST_SIZE
+    this->restore_queue();
+#endif
+#ifdef EHMTXv2_RENDER_TASK
+    this->start_render_task();
+#endif
     ESP_LOGD(TAG, "Setup and running!");
   }
 
   void EHMTX::show_alarm(int r, int g, int b, int size)
   {
+    if (this->post(&EHMTX::show_alarm, r, g, b, size))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "show_alarm");
+    timer.trace(r, g, b, size);
     if (size > 0)
     {
       this->alarm_color = Color((uint8_t)r & 248, (uint8_t)g & 252, (uint8_t)b & 248);
       this->display_alarm = size & 3;
+      this->layer_changed(LAYER_ALARM);
       ESP_LOGD(TAG, "show alarm size: %d color r: %d g: %d b: %d", size, r, g, b);
     }
     else
@@ -373,8 +425,7 @@ namespace esphome
     }
   }
 
-#ifndef USE_ESP8266
-  #ifdef EHMTXv2_BOOTLOGO
+#ifdef EHMTXv2_BOOTLOGO
     void EHMTX::display_boot_logo() {
       this->bitmap_screen(EHMTXv2_BOOTLOGO, 1, 10);
     } 
@@ -382,17 +433,29 @@ namespace esphome
         this->bitmap_small("[2016,0,0,0,2016,0,0,0,2016,0,0,0,2016,0,0,0,2016,0,0,0,2016,0,0,0,0,2016,0,2016,0,31,31,0,0,0,2016,0,31,0,0,31,0,0,0,0,0,0,31,0,0,0,0,0,0,31,0,0,0,0,0,0,31,31,31,31]", EHMTX_VERSION, 1, 10);
     }
 
-  #endif
 #endif
 
   void EHMTX::hide_alarm()
   {
+    if (this->post(&EHMTX::hide_alarm))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "hide_alarm");
+    timer.trace();
     this->display_alarm = 0;
+    this->layer_changed(LAYER_ALARM);
     ESP_LOGD(TAG, "hide alarm");
   }
 
   void EHMTX::set_clock_color(int r, int g, int b)
   {
+    if (this->post(&EHMTX::set_clock_color, r, g, b))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "set_clock_color");
+    timer.trace(r, g, b);
     this->clock_color = Color((uint8_t)r & 248, (uint8_t)g & 252, (uint8_t)b & 248);
     this->del_screen("*", 3);
     this->del_screen("*", 2);
@@ -404,47 +467,111 @@ namespace esphome
 
   void EHMTX::blank_screen(int lifetime, int showtime)
   {
+    if (this->post(&EHMTX::blank_screen, lifetime, showtime))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "blank_screen");
+    timer.trace(lifetime, showtime);
     auto scr = this->find_free_queue_element();
-    scr->screen_time_ = showtime;
     scr->mode = MODE_BLANK;
-    scr->endtime = this->clock->now().timestamp + lifetime * 60;
+    scr->prepare(showtime);
+    scr->endtime = this->uptime() + lifetime * 60;
   }
 
   void EHMTX::update() // called from polling component
   {
+    if (this->post(&EHMTX::update))
+    {
+      // the render task takes the stats and the snapshot, the main loop publishes and saves them
+#ifdef EHMTXv2_STATS
+      this->publish_stats();
+#endif
+#ifdef EHMTXv2_PERSIST_SIZE
+      this->save_snapshot();
+#endif
+      return;
+    }
+    // the queue runs on uptime(), the clock and date screens wait for the time
     if (!this->is_running)
     {
-      if (this->clock->now().is_valid())
-      {
-        ESP_LOGD(TAG, "time sync => start running");
-#ifndef USE_ESP8266
-  #ifdef EHMTXv2_BOOTLOGO
-        this->bitmap_screen(EHMTXv2_BOOTLOGO, 1, 10);
-  #endif
+      ESP_LOGD(TAG, "start running");
+      EHMTX_ServiceTimer internal(this, nullptr);
+#ifdef EHMTXv2_BOOTLOGO
+      this->bitmap_screen(EHMTXv2_BOOTLOGO, 1, 10);
+#endif
+#ifdef EHMTXv2_PERSIST_SIZE
+      // a restored queue brings its own clock
+      if (this->restored_screens == 0)
 #endif
+      {
         this->clock_screen(14 * 24 * 60, this->clock_time, EHMTXv2_DEFAULT_CLOCK_FONT, C_RED, C_GREEN, C_BLUE);
         this->date_screen(14 * 24 * 60, (int)this->clock_time / 2, EHMTXv2_DEFAULT_CLOCK_FONT, C_RED, C_GREEN, C_BLUE);
-        this->is_running = true;
-        for (auto *t : on_start_running_triggers_)
-        {
-          ESP_LOGD(TAG, "on_start_running_triggers");
-          t->process();
-        }
       }
+      this->is_running = true;
+      this->queue_event(EVENT_START_RUNNING, "", "");
     }
     else
     {
+      if (!this->time_synced_ && this->clock->now().is_valid())
+      {
+        this->time_synced_ = true;
+        this->time_synced();
+      }
+      this->check_timers();
+#ifdef EHMTXv2_FRAME_CACHE
+      this->prefetch_frames();
+#endif
+#ifdef EHMTXv2_PERSIST_SIZE
+      this->take_snapshot();
+#endif
+#ifdef EHMTXv2_STATS
+      this->take_stats();
+#endif
     }
+#ifdef EHMTXv2_STATS
+    this->publish_stats();
+#endif
+#ifdef EHMTXv2_PERSIST_SIZE
+    this->save_snapshot();
+#endif
+  }
+
+  // seconds since boot, starts at 1 so an endtime of 0 still marks a free slot, millis() wraps after 49 days
+  time_t EHMTX::uptime()
+  {
+    uint32_t ms = millis();
+    if (ms < this->last_millis_)
+    {
+      this->millis_wraps_++;
+    }
+    this->last_millis_ = ms;
+    return (time_t)((((uint64_t)this->millis_wraps_ << 32) | ms) / 1000) + 1;
+  }
+
+  // the first valid time, from now on the clock and date screens are shown
+  void EHMTX::time_synced()
+  {
+    ESP_LOGD(TAG, "time sync after %d s", (int)this->uptime());
+#ifdef EHMTXv2_PERSIST_SIZE
+    this->rebase_restored();
+#endif
   }
 
   void EHMTX::force_screen(std::string icon_name, int mode)
   {
+    if (this->post(&EHMTX::force_screen, std::move(icon_name), mode))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "force_screen");
+    timer.trace(icon_name, mode);
     for (uint8_t i = 0; i < MAXQUEUE; i++)
     {
       if (this->queue[i]->mode == mode)
       {
         bool force = true;
-        if ((mode == MODE_ICON_SCREEN) || (mode == MODE_FULL_SCREEN) || (mode == MODE_RAINBOW_ICON))
+        if (EHMTX_queue::mode_flags(mode) & (SCREEN_ICON | SCREEN_NAMED))
         {
           if (strcmp(this->queue[i]->icon_name.c_str(), icon_name.c_str()) != 0)
           {
@@ -453,9 +580,10 @@ namespace esphome
           if (force)
           {
             ESP_LOGD(TAG, "force_screen: found position: %d", i);
+            this->forced_screens++;
             this->queue[i]->last_time = 0;
             this->queue[i]->endtime += this->queue[i]->screen_time_;
-            this->next_action_time = this->clock->now().timestamp;
+            this->next_action_time = this->uptime();
             ESP_LOGW(TAG, "force_screen: icon %s in mode %d", icon_name.c_str(), mode);
           }
         }
@@ -465,10 +593,10 @@ namespace esphome
   uint8_t EHMTX::find_oldest_queue_element()
   {
     uint8_t hit = MAXQUEUE;
-    time_t last_time = this->clock->now().timestamp;
+    time_t last_time = this->uptime();
     for (size_t i = 0; i < MAXQUEUE; i++)
     {
-      if ((this->queue[i]->endtime > 0) && (this->queue[i]->last_time < last_time))
+      if ((this->queue[i]->endtime > 0) && (this->queue[i]->last_time < last_time) && this->queue[i]->showable())
       {
         hit = i;
         last_time = this->queue[i]->last_time;
@@ -476,7 +604,7 @@ namespace esphome
     }
     if (hit != MAXQUEUE)
     {
-      this->queue[hit]->status();
+      this->queue[hit]->diag(DIAG_NEXT_SCREEN);
     }
     return hit;
   }
@@ -484,9 +612,9 @@ namespace esphome
   uint8_t EHMTX::find_last_clock()
   {
     uint8_t hit = MAXQUEUE;
-    if (EHMTXv2_CLOCK_INTERVALL > 0)
+    if ((EHMTXv2_CLOCK_INTERVALL > 0) && this->clock->now().is_valid())
     {
-      time_t ts = this->clock->now().timestamp;
+      time_t ts = this->uptime();
       for (size_t i = 0; i < MAXQUEUE; i++)
       {
         if ((this->queue[i]->mode == MODE_CLOCK) || (this->queue[i]->mode == MODE_RAINBOW_CLOCK))
@@ -500,7 +628,7 @@ namespace esphome
       }
       if (hit != MAXQUEUE)
       {
-        ESP_LOGD(TAG, "forced clock_interval");
+        this->diag(DIAG_CLOCK_INTERVAL, hit, this->queue[hit]->mode);
       }
     }
     return hit;
@@ -508,61 +636,71 @@ namespace esphome
 
   void EHMTX::remove_expired_queue_element()
   {
-    if (this->clock->now().is_valid())
-    {
-      std::string infotext;
-      time_t ts = this->clock->now().timestamp;
+    std::string infotext;
+    time_t ts = this->uptime();
 
-      for (size_t i = 0; i < MAXQUEUE; i++)
+    for (size_t i = 0; i < MAXQUEUE; i++)
+    {
+      if ((this->queue[i]->endtime > 0) && (this->queue[i]->endtime < ts))
       {
-        if ((this->queue[i]->endtime > 0) && (this->queue[i]->endtime < ts))
+        this->queue[i]->endtime = 0;
+        if (this->queue[i]->mode != MODE_EMPTY)
         {
-          this->queue[i]->endtime = 0;
-          if (this->queue[i]->mode != MODE_EMPTY)
+          this->queue[i]->diag(DIAG_SCREEN_EXPIRED);
+          if (this->has_triggers(EVENT_EXPIRED_SCREEN))
           {
-            ESP_LOGD(TAG, "remove expired queue element: slot %d: mode: %d icon_name: %s text: %s", i, this->queue[i]->mode, this->queue[i]->icon_name.c_str(), this->queue[i]->text.c_str());
-            for (auto *t : on_expired_screen_triggers_)
+            infotext = "";
+            switch (this->queue[i]->mode)
             {
-              infotext = "";
-              switch (this->queue[i]->mode)
-              {
-              case MODE_EMPTY:
-                break;
-              case MODE_BLANK:
-                break;
-              case MODE_CLOCK:
-                infotext = "clock";
-                break;
-              case MODE_DATE:
-                infotext = "clock";
-                break;
-              case MODE_FULL_SCREEN:
-                infotext = "full screen " + this->queue[i]->icon_name;
-                break;
-              case MODE_ICON_SCREEN:
-              case MODE_RAINBOW_ICON:
-                infotext = this->queue[i]->icon_name.c_str();
-                break;
-              case MODE_RAINBOW_TEXT:
-              case MODE_TEXT_SCREEN:
-                infotext = "TEXT";
-                break;
-              case MODE_BITMAP_SCREEN:
-                infotext = "BITMAP";
-                break;
-              default:
-                break;
-              }
-              t->process(this->queue[i]->icon_name, infotext);
+            case MODE_EMPTY:
+              break;
+            case MODE_BLANK:
+              break;
+            case MODE_CLOCK:
+              infotext = "clock";
+              break;
+            case MODE_DATE:
+              infotext = "clock";
+              break;
+            case MODE_FULL_SCREEN:
+              infotext = "full screen " + this->queue[i]->icon_name;
+              break;
+            case MODE_ICON_SCREEN:
+            case MODE_RAINBOW_ICON:
+              infotext = this->queue[i]->icon_name.c_str();
+              break;
+            case MODE_RAINBOW_TEXT:
+            case MODE_TEXT_SCREEN:
+              infotext = "TEXT";
+              break;
+            case MODE_BITMAP_SCREEN:
+              infotext = "BITMAP";
+              break;
+            default:
+              break;
             }
+            this->queue_event(EVENT_EXPIRED_SCREEN, this->queue[i]->icon_name, infotext);
           }
-          this->queue[i]->mode = MODE_EMPTY;
+          this->queue_expiries++;
         }
+        this->queue[i]->mode = MODE_EMPTY;
       }
     }
   }
   void EHMTX::tick()
   {
+#ifdef EHMTXv2_RENDER_TASK
+    if ((this->render_task_ != nullptr) && !this->in_render_task())
+    {
+      return; // the render task ticks, the display lambda only shows its frames
+    }
+#endif
+    uint32_t start = micros();
+#ifdef EHMTXv2_COUNT_ALLOCATIONS
+    uint32_t allocations = EHMTX_allocations;
+#endif
+    this->frame_started(start);
+
     this->hue_++;
     if (this->hue_ == 360)
     {
@@ -572,11 +710,11 @@ namespace esphome
     esphome::hsv_to_rgb(this->hue_, 0.8, 0.8, red, green, blue);
     this->rainbow_color = Color(uint8_t(255 * red), uint8_t(255 * green), uint8_t(255 * blue));
     
-    if (this->is_running && this->clock->now().is_valid())
+    if (this->is_running)
     {
-      time_t ts = this->clock->now().timestamp;
+      time_t ts = this->uptime();
 
-      if (millis() - this->last_scroll_time >= EHMTXv2_SCROLL_INTERVALL)
+      if ((millis() - this->last_scroll_time >= EHMTXv2_SCROLL_INTERVALL) && (this->screen_pointer != MAXQUEUE))
       {
         this->scroll_step++;
         this->last_scroll_time = millis();
@@ -588,6 +726,7 @@ namespace esphome
 
       if (ts > this->next_action_time)
       {
+        uint8_t previous = this->screen_pointer;
         this->remove_expired_queue_element();
         this->screen_pointer = this->find_last_clock();
         this->scroll_step = 0;
@@ -602,34 +741,31 @@ namespace esphome
         {
 
           this->queue[this->screen_pointer]->last_time = ts + this->queue[this->screen_pointer]->screen_time_;
-          if (this->queue[this->screen_pointer]->icon < this->icon_count)
-          {
-            this->icons[this->queue[this->screen_pointer]->icon]->set_frame(0);
-          }
+          this->queue[this->screen_pointer]->anim_start = millis();
           this->next_action_time = this->queue[this->screen_pointer]->last_time;
+          this->screen_started(previous);
           // Todo switch for Triggers
           if (this->queue[this->screen_pointer]->mode == MODE_CLOCK)
           {
-            for (auto *t : on_next_clock_triggers_)
-            {
-              t->process();
-            }
+            this->queue_event(EVENT_NEXT_CLOCK, "", "");
           }
           else
           {
-            for (auto *t : on_next_screen_triggers_)
-            {
-              t->process(this->queue[this->screen_pointer]->icon_name, this->queue[this->screen_pointer]->text);
-            }
+            this->queue_event(EVENT_NEXT_SCREEN, this->queue[this->screen_pointer]->icon_name, this->queue[this->screen_pointer]->text);
           }
         }
         else
         {
 #ifndef EHMTXv2_ALLOW_EMPTY_SCREEN
-          ESP_LOGW(TAG, "tick: nothing to do. Restarting clock display!");
-          this->clock_screen(24 * 60, this->clock_time, false, this->clock_color[0], this->clock_color[1], this->clock_color[2]);
-          this->date_screen(24 * 60, (int)this->clock_time / 2, false, C_RED, C_GREEN, C_BLUE);
-          this->next_action_time = ts + this->clock_time;
+          // without time the clock would not be shown either, the boot animation runs until a screen arrives
+          if (this->clock->now().is_valid())
+          {
+            ESP_LOGW(TAG, "tick: nothing to do. Restarting clock display!");
+            EHMTX_ServiceTimer internal(this, nullptr);
+            this->clock_screen(24 * 60, this->clock_time, false, this->clock_color[0], this->clock_color[1], this->clock_color[2]);
+            this->date_screen(24 * 60, (int)this->clock_time / 2, false, C_RED, C_GREEN, C_BLUE);
+            this->next_action_time = ts + this->clock_time;
+          }
 #endif
         }
       }
@@ -640,32 +776,54 @@ namespace esphome
       {
           uint8_t b = this->brightness_;
           float br = lerp((float)this->ticks_ / EHMTXv2_BLEND_STEPS, 0, (float)b / 255);
-          this->display->get_light()->set_correction(br, br, br);
+          this->set_correction(br);
       }
 #endif
     this->ticks_++;
     }
-    else
+    if (!this->is_running || ((this->screen_pointer == MAXQUEUE) && !this->clock->now().is_valid()))
     {
-      uint8_t w = (2 + (uint8_t)(32 / 16) * (this->boot_anim / 16)) % 32;
-      this->display->rectangle(0, 2, w, 4, this->rainbow_color); // Color(120, 190, 40));
+      uint8_t w = (2 + (uint8_t)(MATRIX_WIDTH / 16) * (this->boot_anim / 16)) % MATRIX_WIDTH;
+      this->target->rectangle(0, 2, w, 4, this->rainbow_color); // Color(120, 190, 40));
       this->boot_anim++;
     }
+#ifdef EHMTXv2_STATS
+    this->tick_time.add(micros() - start);
+#endif
+#ifdef EHMTXv2_COUNT_ALLOCATIONS
+    this->frame_allocations += EHMTX_allocations - allocations;
+#endif
   }
 
   void EHMTX::skip_screen()
   {
-    this->next_action_time = this->clock->now().timestamp - 1;
+    if (this->post(&EHMTX::skip_screen))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "skip_screen");
+    timer.trace();
+    this->skipped_screens++;
+    this->next_action_time = this->uptime() - 1;
   }
 
   void EHMTX::hold_screen(int time)
   {
-    this->next_action_time = this->clock->now().timestamp + time;
+    if (this->post(&EHMTX::hold_screen, time))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "hold_screen");
+    timer.trace(time);
+    this->next_action_time = this->uptime() + time;
   }
 
   void EHMTX::get_status()
   {
-    time_t ts = this->clock->now().timestamp;
+    if (this->post(&EHMTX::get_status))
+    {
+      return;
+    }
     ESP_LOGI(TAG, "status time: %d.%d.%d %02d:%02d", this->clock->now().day_of_month,
              this->clock->now().month, this->clock->now().year,
              this->clock->now().hour, this->clock->now().minute);
@@ -681,6 +839,7 @@ namespace esphome
     {
       ESP_LOGI(TAG, "status display off");
     }
+    this->stats_status();
 
     this->queue_status();
   }
@@ -699,31 +858,36 @@ namespace esphome
       ESP_LOGI(TAG, "queue: %d empty slots", empty);
   }
 
-  void EHMTX::set_default_font(display::BaseFont *font)
+  void EHMTX::set_default_font(font::Font *font)
   {
     this->default_font = font;
   }
 
-  void EHMTX::set_special_font(display::BaseFont *font)
+  void EHMTX::set_special_font(font::Font *font)
   {
     this->special_font = font;
   }
 
   void EHMTX::del_screen(std::string icon_name, int mode)
   {
+    if (this->post(&EHMTX::del_screen, std::move(icon_name), mode))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "del_screen");
+    timer.trace(icon_name, mode);
     for (uint8_t i = 0; i < MAXQUEUE; i++)
     {
       if (this->queue[i]->mode == mode)
       {
         bool force = true;
         ESP_LOGD(TAG, "del_screen: icon %s in position: %s mode %d", icon_name.c_str(), this->queue[i]->icon_name.c_str(), mode);
-        if ((mode == MODE_ICON_SCREEN) || (mode == MODE_FULL_SCREEN) || (mode == MODE_RAINBOW_ICON))
+        if (EHMTX_queue::mode_flags(mode) & (SCREEN_ICON | SCREEN_NAMED))
         {
           if (this->string_has_ending(icon_name, "*"))
           {
-            std::string comparename = icon_name.substr(0, icon_name.length() - 1);
-            
-            if (this->queue[i]->icon_name.rfind(comparename, 0) != 0)
+            // prefix match without copying the prefix
+            if (this->queue[i]->icon_name.compare(0, icon_name.length() - 1, icon_name, 0, icon_name.length() - 1) != 0)
             {
               force = false;
             }
@@ -740,7 +904,7 @@ namespace esphome
           this->queue[i]->endtime = 0;
           if (i == this->screen_pointer)
           {
-            this->next_action_time = this->clock->now().timestamp;
+            this->next_action_time = this->uptime();
           }
         }
       }
@@ -749,68 +913,72 @@ namespace esphome
 
   void EHMTX::icon_screen(std::string iconname, std::string text, int lifetime, int screen_time, bool default_font, int r, int g, int b)
   {
-    uint8_t icon = this->find_icon(iconname.c_str());
+    if (this->post(&EHMTX::icon_screen, std::move(iconname), std::move(text), lifetime, screen_time, default_font, r, g, b))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "icon_screen");
+    timer.trace(iconname, text, lifetime, screen_time, default_font, r, g, b);
+    uint8_t icon = this->find_icon(iconname);
 
     if (icon >= this->icon_count)
     {
       ESP_LOGW(TAG, "icon %d not found => default: 0", icon);
       icon = 0;
-      for (auto *t : on_icon_error_triggers_)
-      {
-        t->process(iconname);
-      }
+      this->queue_event(EVENT_ICON_ERROR, iconname, "");
     }
     EHMTX_queue *screen = this->find_icon_queue_element(icon);
 
-    screen->text = text;
-    screen->endtime = this->clock->now().timestamp + lifetime * 60;
+    screen->text = std::move(text);
+    screen->endtime = this->uptime() + lifetime * 60;
     screen->text_color = Color(r, g, b);
     screen->default_font = default_font;
     screen->mode = MODE_ICON_SCREEN;
-    screen->icon_name = iconname;
+    screen->icon_name = std::move(iconname);
     screen->icon = icon;
-    screen->calc_scroll_time(text, screen_time);
-    for (auto *t : on_add_screen_triggers_)
-    {
-      t->process(screen->icon_name, (uint8_t)screen->mode);
-    }
-    ESP_LOGD(TAG, "icon screen icon: %d iconname: %s text: %s lifetime: %d screen_time: %d", icon, iconname.c_str(), text.c_str(), lifetime, screen_time);
-    screen->status();
+    screen->prepare(screen_time);
+    this->queue_event(EVENT_ADD_SCREEN, screen->icon_name, "", screen->mode);
+    screen->diag(DIAG_SCREEN_ADDED);
   }
 
   void EHMTX::rainbow_icon_screen(std::string iconname, std::string text, int lifetime, int screen_time, bool default_font)
   {
-    uint8_t icon = this->find_icon(iconname.c_str());
+    if (this->post(&EHMTX::rainbow_icon_screen, std::move(iconname), std::move(text), lifetime, screen_time, default_font))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "rainbow_icon_screen");
+    timer.trace(iconname, text, lifetime, screen_time, default_font);
+    uint8_t icon = this->find_icon(iconname);
 
     if (icon >= this->icon_count)
     {
       ESP_LOGW(TAG, "icon %d not found => default: 0", icon);
       icon = 0;
-      for (auto *t : on_icon_error_triggers_)
-      {
-        t->process(iconname);
-      }
+      this->queue_event(EVENT_ICON_ERROR, iconname, "");
     }
     EHMTX_queue *screen = this->find_icon_queue_element(icon);
 
-    screen->text = text;
+    screen->text = std::move(text);
 
-    screen->endtime = this->clock->now().timestamp + lifetime * 60;
+    screen->endtime = this->uptime() + lifetime * 60;
     screen->default_font = default_font;
     screen->mode = MODE_RAINBOW_ICON;
-    screen->icon_name = iconname;
+    screen->icon_name = std::move(iconname);
     screen->icon = icon;
-    screen->calc_scroll_time(text, screen_time);
-    for (auto *t : on_add_screen_triggers_)
-    {
-      t->process(screen->icon_name, (uint8_t)screen->mode);
-    }
-    ESP_LOGD(TAG, "rainbow icon screen icon: %d iconname: %s text: %s lifetime: %d screen_time: %d", icon, iconname.c_str(), text.c_str(), lifetime, screen_time);
-    screen->status();
+    screen->prepare(screen_time);
+    this->queue_event(EVENT_ADD_SCREEN, screen->icon_name, "", screen->mode);
+    screen->diag(DIAG_SCREEN_ADDED);
   }
 
   void EHMTX::rainbow_clock_screen(int lifetime, int screen_time, bool default_font)
   {
+    if (this->post(&EHMTX::rainbow_clock_screen, lifetime, screen_time, default_font))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "rainbow_clock_screen");
+    timer.trace(lifetime, screen_time, default_font);
     EHMTX_queue *screen = this->find_free_queue_element();
 
     ESP_LOGD(TAG, "rainbow_clock_screen lifetime: %d screen_time: %d", lifetime, screen_time);
@@ -818,18 +986,24 @@ namespace esphome
     screen->default_font = default_font;
     if (EHMTXv2_CLOCK_INTERVALL == 0 || (EHMTXv2_CLOCK_INTERVALL > screen_time))
     {
-      screen->screen_time_ = screen_time;
+      screen->prepare(screen_time);
     }
     else
     {
-      screen->screen_time_ = EHMTXv2_CLOCK_INTERVALL - 2;
+      screen->prepare(EHMTXv2_CLOCK_INTERVALL - 2);
     }
-    screen->endtime = this->clock->now().timestamp + lifetime * 60;
-    screen->status();
+    screen->endtime = this->uptime() + lifetime * 60;
+    screen->diag(DIAG_SCREEN_ADDED);
   }
 
   void EHMTX::rainbow_date_screen(int lifetime, int screen_time, bool default_font)
   {
+    if (this->post(&EHMTX::rainbow_date_screen, lifetime, screen_time, default_font))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "rainbow_date_screen");
+    timer.trace(lifetime, screen_time, default_font);
     ESP_LOGD(TAG, "rainbow_date_screen lifetime: %d screen_time: %d", lifetime, screen_time);
     if (this->show_date)
     {
@@ -837,9 +1011,9 @@ namespace esphome
 
       screen->mode = MODE_RAINBOW_DATE;
       screen->default_font = default_font;
-      screen->screen_time_ = screen_time;
-      screen->endtime = this->clock->now().timestamp + lifetime * 60;
-      screen->status();
+      screen->prepare(screen_time);
+      screen->endtime = this->uptime() + lifetime * 60;
+      screen->diag(DIAG_SCREEN_ADDED);
     }
     else
     {
@@ -849,70 +1023,93 @@ namespace esphome
 
   void EHMTX::text_screen(std::string text, int lifetime, int screen_time, bool default_font, int r, int g, int b)
   {
+    if (this->post(&EHMTX::text_screen, std::move(text), lifetime, screen_time, default_font, r, g, b))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "text_screen");
+    timer.trace(text, lifetime, screen_time, default_font, r, g, b);
     EHMTX_queue *screen = this->find_free_queue_element();
 
-    screen->text = text;
-    screen->endtime = this->clock->now().timestamp + lifetime * 60;
+    screen->text = std::move(text);
+    screen->endtime = this->uptime() + lifetime * 60;
     screen->default_font = default_font;
     screen->text_color = Color(r, g, b);
     screen->mode = MODE_TEXT_SCREEN;
-    screen->calc_scroll_time(text, screen_time);
-    screen->status();
+    screen->prepare(screen_time);
+    screen->diag(DIAG_SCREEN_ADDED);
   }
 
   void EHMTX::rainbow_text_screen(std::string text, int lifetime, int screen_time, bool default_font)
   {
+    if (this->post(&EHMTX::rainbow_text_screen, std::move(text), lifetime, screen_time, default_font))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "rainbow_text_screen");
+    timer.trace(text, lifetime, screen_time, default_font);
     EHMTX_queue *screen = this->find_free_queue_element();
-    screen->text = text;
-    screen->endtime = this->clock->now().timestamp + lifetime * 60;
+    screen->text = std::move(text);
+    screen->endtime = this->uptime() + lifetime * 60;
     screen->default_font = default_font;
     screen->mode = MODE_RAINBOW_TEXT;
-    screen->calc_scroll_time(text, screen_time);
-    screen->status();
+    screen->prepare(screen_time);
+    screen->diag(DIAG_SCREEN_ADDED);
   }
 
   void EHMTX::full_screen(std::string iconname, int lifetime, int screen_time)
   {
-    uint8_t icon = this->find_icon(iconname.c_str());
+    if (this->post(&EHMTX::full_screen, std::move(iconname), lifetime, screen_time))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "full_screen");
+    timer.trace(iconname, lifetime, screen_time);
+    uint8_t icon = this->find_icon(iconname);
 
     if (icon >= this->icon_count)
     {
       ESP_LOGW(TAG, "full screen: icon %d not found => default: 0", icon);
-      for (auto *t : on_icon_error_triggers_)
-      {
-        t->process(iconname);
-      }
+      this->queue_event(EVENT_ICON_ERROR, iconname, "");
       icon = 0;
     }
     EHMTX_queue *screen = this->find_icon_queue_element(icon);
 
     screen->mode = MODE_FULL_SCREEN;
     screen->icon = icon;
-    screen->icon_name = iconname;
-    screen->screen_time_ = screen_time;
-    screen->endtime = this->clock->now().timestamp + lifetime * 60;
-    for (auto *t : on_add_screen_triggers_)
-    {
-      t->process(screen->icon_name, (uint8_t)screen->mode);
-    }
-    ESP_LOGD(TAG, "full screen: icon: %d iconname: %s lifetime: %d screen_time:%d ", icon, iconname.c_str(), lifetime, screen_time);
-    screen->status();
+    screen->icon_name = std::move(iconname);
+    screen->prepare(screen_time);
+    screen->endtime = this->uptime() + lifetime * 60;
+    this->queue_event(EVENT_ADD_SCREEN, screen->icon_name, "", screen->mode);
+    screen->diag(DIAG_SCREEN_ADDED);
   }
 
   void EHMTX::clock_screen(int lifetime, int screen_time, bool default_font, int r, int g, int b)
   {
+    if (this->post(&EHMTX::clock_screen, lifetime, screen_time, default_font, r, g, b))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "clock_screen");
+    timer.trace(lifetime, screen_time, default_font, r, g, b);
     EHMTX_queue *screen = this->find_free_queue_element();
     screen->text_color = Color(r, g, b);
     ESP_LOGD(TAG, "clock_screen_color lifetime: %d screen_time: %d red: %d green: %d blue: %d", lifetime, screen_time, r, g, b);
     screen->mode = MODE_CLOCK;
     screen->default_font = default_font;
-    screen->screen_time_ = screen_time;
-    screen->endtime = this->clock->now().timestamp + lifetime * 60;
-    screen->status();
+    screen->prepare(screen_time);
+    screen->endtime = this->uptime() + lifetime * 60;
+    screen->diag(DIAG_SCREEN_ADDED);
   }
 
   void EHMTX::date_screen(int lifetime, int screen_time, bool default_font, int r, int g, int b)
   {
+    if (this->post(&EHMTX::date_screen, lifetime, screen_time, default_font, r, g, b))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "date_screen");
+    timer.trace(lifetime, screen_time, default_font, r, g, b);
     ESP_LOGD(TAG, "date_screen lifetime: %d screen_time: %d red: %d green: %d blue: %d", lifetime, screen_time, r, g, b);
     if (this->show_date)
     {
@@ -921,10 +1118,10 @@ namespace esphome
       screen->text_color = Color(r, g, b);
 
       screen->mode = MODE_DATE;
-      screen->screen_time_ = screen_time;
       screen->default_font = default_font;
-      screen->endtime = this->clock->now().timestamp + lifetime * 60;
-      screen->status();
+      screen->prepare(screen_time);
+      screen->endtime = this->uptime() + lifetime * 60;
+      screen->diag(DIAG_SCREEN_ADDED);
     }
     else
     {
@@ -938,7 +1135,11 @@ namespace esphome
     {
       if ((this->queue[i]->mode == MODE_ICON_SCREEN) && (this->queue[i]->icon == icon))
       {
-        ESP_LOGD(TAG, "free_screen: found by icon");
+        this->diag(DIAG_SLOT_BY_ICON, i, this->queue[i]->mode, icon);
+        this->queue_updates++;
+        this->queue[i]->added_time = millis();
+        this->queue[i]->waiting = true;
+        this->queue[i]->restored = false;
         return this->queue[i];
       }
     }
@@ -947,15 +1148,19 @@ namespace esphome
 
   EHMTX_queue *EHMTX::find_free_queue_element()
   {
-    time_t ts = this->clock->now().timestamp;
+    time_t ts = this->uptime();
     for (size_t i = 0; i < MAXQUEUE; i++)
     {
       if (this->queue[i]->endtime < ts)
       {
-        ESP_LOGD(TAG, "free_screen: found by endtime %d", i);
+        this->diag(DIAG_SLOT_FREE, i);
+        this->queue_inserted(this->queue[i]);
         return this->queue[i];
       }
     }
+    ESP_LOGW(TAG, "free_screen: queue full, overwriting slot 0");
+    this->queue_evictions++;
+    this->queue_inserted(this->queue[0]);
     return this->queue[0];
   }
 
@@ -1000,15 +1205,34 @@ namespace esphome
 
   void EHMTX::set_brightness(int value)
   {
+    if (this->post(&EHMTX::set_brightness, value))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "set_brightness");
+    timer.trace(value);
     if (value < 256)
     {
       this->brightness_ = value;
       float br = (float)value / (float)255;
       ESP_LOGI(TAG, "set_brightness %d => %.2f %%", value, 100 * br);
-      this->display->get_light()->set_correction(br, br, br);
+      this->set_correction(br);
     }
   }
 
+  // the light belongs to the main loop, the render task leaves the value for loop()
+  void EHMTX::set_correction(float brightness)
+  {
+#ifdef EHMTXv2_RENDER_TASK
+    if (this->in_render_task())
+    {
+      this->correction_.store(brightness, std::memory_order_release);
+      return;
+    }
+#endif
+    this->display->get_light()->set_correction(brightness, brightness, brightness);
+  }
+
   uint8_t EHMTX::get_brightness()
   {
     return this->brightness_;
@@ -1022,6 +1246,7 @@ namespace esphome
   void EHMTX::set_display(addressable_light::AddressableLightDisplay *disp)
   {
     this->display = disp;
+    this->target = disp;
     this->show_display = true;
     ESP_LOGD(TAG, "set_display");
   }
@@ -1037,16 +1262,18 @@ namespace esphome
     if (this->show_day_of_week)
     {
       auto dow = this->clock->now().day_of_week - 1; // SUN = 0
+      // 7 bars with one pixel gap, 3 pixels wide on 32 columns
+      const uint8_t step = MATRIX_WIDTH / 8;
       for (uint8_t i = 0; i <= 6; i++)
       {
         if (((!EHMTXv2_WEEK_START) && (dow == i)) ||
             ((EHMTXv2_WEEK_START) && ((dow == (i + 1)) || ((dow == 0 && i == 6)))))
         {
-          this->display->line(2 + i * 4, 7, i * 4 + 4, 7, this->today_color);
+          this->target->line(step / 2 + i * step, 7, i * step + step, 7, this->today_color);
         }
         else
         {
-          this->display->line(2 + i * 4, 7, i * 4 + 4, 7, this->weekday_color);
+          this->target->line(step / 2 + i * step, 7, i * step + step, 7, this->weekday_color);
         }
       }
     }
@@ -1091,116 +1318,31 @@ namespace esphome
     this->icon_count++;
   }
 
-  void EHMTX::draw_alarm()
-  {
-    if (this->display_alarm > 2)
-    {
-      this->display->line(31, 2, 29, 0, this->alarm_color);
-    }
-    if (this->display_alarm > 1)
-    {
-      this->display->draw_pixel_at(30, 0, this->alarm_color);
-      this->display->draw_pixel_at(31, 1, this->alarm_color);
-    }
-    if (this->display_alarm > 0)
-    {
-      this->display->draw_pixel_at(31, 0, this->alarm_color);
-    }
-  }
-
-  void EHMTX::draw_rindicator()
-  {
-    if (this->display_rindicator > 2)
-    {
-      this->display->line(31, 5, 29, 7, this->rindicator_color);
-    }
-
-    if (this->display_rindicator > 1)
-    {
-      this->display->draw_pixel_at(30, 7, this->rindicator_color);
-      this->display->draw_pixel_at(31, 6, this->rindicator_color);
-    }
-
-    if (this->display_rindicator > 0)
-    {
-      this->display->draw_pixel_at(31, 7, this->rindicator_color);
-    }
-  }
-
-  void EHMTX::draw_lindicator()
+  void EHMTX::draw()
   {
-    if (this->display_lindicator > 2)
+#ifdef EHMTXv2_RENDER_TASK
+    if ((this->render_task_ != nullptr) && !this->in_render_task())
     {
-      this->display->line(0, 5, 2, 7, this->lindicator_color);
+      this->frame_buffer_->show(this->display);
+      return;
     }
-
-    if (this->display_lindicator > 1)
-    {
-      this->display->draw_pixel_at(1, 7, this->lindicator_color);
-      this->display->draw_pixel_at(0, 6, this->lindicator_color);
-    }
-
-    if (this->display_lindicator > 0)
-    {
-      this->display->draw_pixel_at(0, 7, this->lindicator_color);
-    }
-  }
-
-  void EHMTX::draw()
-  {
+#endif
+#ifdef EHMTXv2_STATS
+    uint32_t start = micros();
+#endif
+#ifdef EHMTXv2_COUNT_ALLOCATIONS
+    uint32_t allocations = EHMTX_allocations;
+#endif
     if ((this->is_running) && (this->show_display) && (this->screen_pointer != MAXQUEUE))
     {
       this->queue[this->screen_pointer]->draw();
-      if (this->queue[this->screen_pointer]->mode != MODE_FULL_SCREEN && this->queue[this->screen_pointer]->mode != MODE_BITMAP_SCREEN)
-      {
-        this->draw_gauge();
-      }
-      #ifndef EHMTXv2_ALWAYS_SHOW_RLINDICATORS
-        if (this->queue[this->screen_pointer]->mode != MODE_CLOCK && this->queue[this->screen_pointer]->mode != MODE_DATE && this->queue[this->screen_pointer]->mode != MODE_FULL_SCREEN && this->queue[this->screen_pointer]->mode != MODE_BITMAP_SCREEN)
-        {
-      #endif
-
-        this->draw_rindicator();
-      #ifndef EHMTXv2_ALWAYS_SHOW_RLINDICATORS
-        if (this->queue[this->screen_pointer]->mode != MODE_ICON_SCREEN && this->queue[this->screen_pointer]->mode != MODE_RAINBOW_ICON && !this->display_gauge)
-        {
-      #endif
-          this->draw_lindicator();
-      #ifndef EHMTXv2_ALWAYS_SHOW_RLINDICATORS
-        }
-      }
-    #endif
-      this->draw_alarm();
+      this->draw_layers(this->queue[this->screen_pointer]->mode);
     }
-  }
-
-  void EHMTXStartRunningTrigger::process()
-  {
-    this->trigger();
-  }
-
-  void EHMTXNextScreenTrigger::process(std::string iconname, std::string text)
-  {
-    this->trigger(iconname, text);
-  }
-
-  void EHMTXAddScreenTrigger::process(std::string iconname, uint8_t mode)
-  {
-    this->trigger(iconname, mode);
-  }
-
-  void EHMTXIconErrorTrigger::process(std::string iconname)
-  {
-    this->trigger(iconname);
-  }
-
-  void EHMTXExpiredScreenTrigger::process(std::string iconname, std::string text)
-  {
-    this->trigger(iconname, text);
-  }
-
-  void EHMTXNextClockTrigger::process()
-  {
-    this->trigger();
+#ifdef EHMTXv2_STATS
+    this->draw_time.add(micros() - start);
+#endif
+#ifdef EHMTXv2_COUNT_ALLOCATIONS
+    this->frame_allocations += EHMTX_allocations - allocations;
+#endif
   }
 }
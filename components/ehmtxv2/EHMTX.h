@@ -2,8 +2,30 @@
 #define EHMTX_H
 #include "esphome.h"
 
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <tuple>
+#include <utility>
 #include "esphome/components/time/real_time_clock.h"
 #include "esphome/components/animation/animation.h"
+#include "esphome/components/font/font.h"
+#ifdef USE_SENSOR
+#include "esphome/components/sensor/sensor.h"
+#endif
+#ifdef EHMTXv2_RENDER_TASK
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
+
+// panel size, the width is set by matrix_width, the fonts, icons, graph, ticker and timer are laid out for 8 rows
+#ifndef EHMTXv2_WIDTH
+#define EHMTXv2_WIDTH 32
+#endif
+constexpr uint8_t MATRIX_WIDTH = EHMTXv2_WIDTH;
+constexpr uint8_t MATRIX_HEIGHT = 8;
+constexpr uint16_t MATRIX_PIXELS = MATRIX_WIDTH * MATRIX_HEIGHT;
+static_assert((EHMTXv2_WIDTH >= 16) && (EHMTXv2_WIDTH <= 255), "matrix_width must be 16..255");
 
 const uint8_t MAXQUEUE = 24;
 const uint8_t C_RED = 240; // default
@@ -22,9 +44,18 @@ const uint8_t D_SCREEN_TIME = 10;
 
 const uint8_t MAXICONS = 90;
 const uint8_t TEXTSCROLLSTART = 8;
-const uint8_t TEXTSTARTOFFSET = (32 - 8);
+const uint8_t TEXTSTARTOFFSET = (MATRIX_WIDTH - 8);
 
 const uint16_t POLLINGINTERVAL = 250;
+const uint16_t COMMAND_QUEUE = 32; // service calls waiting for the render task
+const uint8_t COMMAND_SIZE = 128;  // bytes of the arguments of such a call, stored in the queue slot
+const uint16_t EVENT_QUEUE = 32;   // trigger events waiting for loop()
+const uint16_t LOG_QUEUE = 32;     // log lines of the render task waiting for loop()
+const uint8_t LOG_LINE = 96;       // bytes of such a line, longer ones are cut
+const uint8_t TICKER_SEGMENTS = 8;  // appended texts the ticker keeps, the oldest is dropped when it is full
+const uint16_t TICKER_CHARS = 256;  // bytes of one appended text, longer ones are cut
+const uint8_t GRAPHS = 4;           // graphs with their own samples, the least recently fed one is reused
+const uint8_t STATS_BUCKETS = 80; // 4 buckets per power of two, up to ~1s
 static const char *const EHMTX_VERSION = "2023.7.1";
 static const char *const TAG = "EHMTXv2";
 
@@ -42,11 +73,123 @@ enum show_mode : uint8_t
   MODE_RAINBOW_CLOCK = 9,
   MODE_RAINBOW_DATE = 10,
   MODE_BITMAP_SCREEN = 11,
-  MODE_BITMAP_SMALL = 12
+  MODE_BITMAP_SMALL = 12,
+  MODE_TICKER = 13,
+  MODE_GRAPH = 14,
+  MODE_TIMER = 15,
+  MODE_COUNT = 16
 };
 
+// EHMTX_ScreenType::flags
+const uint8_t SCREEN_ICON = 1; // shows queue->icon
+const uint8_t SCREEN_TEXT = 2; // shows queue->text
+const uint8_t SCREEN_TIME = 4; // shows the time, skipped until the clock is valid
+const uint8_t SCREEN_NAMED = 8; // icon_name names the screen, it is shown without the icon when there is none
+
+// overlays above the screen in drawing order, see EHMTX_layers.cpp
+enum layer_id : uint8_t
+{
+  LAYER_GAUGE = 0,
+  LAYER_RINDICATOR = 1,
+  LAYER_LINDICATOR = 2,
+  LAYER_ALARM = 3,
+  LAYER_COUNT = 4
+};
+
+// the triggers, queued by queue_event() and dispatched by loop(), see EHMTX_events.cpp
+enum event_type : uint8_t
+{
+  EVENT_NEXT_SCREEN = 0,
+  EVENT_NEXT_CLOCK = 1,
+  EVENT_EXPIRED_SCREEN = 2,
+  EVENT_ADD_SCREEN = 3,
+  EVENT_ICON_ERROR = 4,
+  EVENT_START_RUNNING = 5,
+  EVENT_TIMER_DONE = 6
+};
+
+// records in the diag ring, see EHMTX_trace.cpp for their decoding
+enum diag_event : uint8_t
+{
+  DIAG_ICON_FOUND = 0,     // find_icon(): icon
+  DIAG_ICON_IN_QUEUE = 1,  // find_icon_in_queue(): slot, icon
+  DIAG_SLOT_BY_ICON = 2,   // find_icon_queue_element(): slot, icon
+  DIAG_SLOT_FREE = 3,      // find_free_queue_element(): slot
+  DIAG_SCREEN_ADDED = 4,   // slot, mode, icon, screen time, text pixels
+  DIAG_NEXT_SCREEN = 5,    // find_oldest_queue_element(): slot, mode, icon, screen time, text pixels
+  DIAG_CLOCK_INTERVAL = 6, // find_last_clock(): slot
+  DIAG_SCREEN_EXPIRED = 7, // remove_expired_queue_element(): slot, mode, icon, screen time, text pixels
+  DIAG_EVENT_COUNT = 8
+};
+
+enum stat_sensor : uint8_t
+{
+  STAT_TICK_P50 = 0,
+  STAT_TICK_P95 = 1,
+  STAT_TICK_MAX = 2,
+  STAT_DRAW_P50 = 3,
+  STAT_DRAW_P95 = 4,
+  STAT_DRAW_MAX = 5,
+  STAT_SERVICE_P50 = 6,
+  STAT_SERVICE_P95 = 7,
+  STAT_SERVICE_MAX = 8,
+  STAT_LATE_FRAMES = 9,
+  STAT_DROPPED_FRAMES = 10,
+  STAT_QUEUE_OCCUPIED = 11,
+  STAT_QUEUE_PEAK = 12,
+  STAT_QUEUE_INSERTS = 13,
+  STAT_QUEUE_UPDATES = 14,
+  STAT_QUEUE_EVICTIONS = 15,
+  STAT_QUEUE_EXPIRIES = 16,
+  STAT_FORCED_SCREENS = 17,
+  STAT_SKIPPED_SCREENS = 18,
+  STAT_WAIT_P50 = 19,
+  STAT_WAIT_P95 = 20,
+  STAT_WAIT_MAX = 21,
+  STAT_DWELL_P50 = 22,
+  STAT_DWELL_P95 = 23,
+  STAT_DWELL_MAX = 24,
+  STAT_FRAME_CACHE_HITS = 25,
+  STAT_DROPPED_EVENTS = 26,
+  STAT_COUNT = 27
+};
+
+#ifdef EHMTXv2_COUNT_ALLOCATIONS
+extern uint32_t EHMTX_allocations; // operator new calls since boot, see EHMTX_stats.cpp
+#endif
+
+#ifdef EHMTXv2_RENDER_TASK
+namespace esphome
+{
+  // false outside of the render task, in it the line is queued and EHMTX_flush_log() writes it from loop()
+  bool EHMTX_defer_log(uint8_t level, const char *tag, const char *format, ...) __attribute__((format(printf, 3, 4)));
+  void EHMTX_flush_log();
+}
+
+// the logger and its API subscribers are not safe to call from the render task
+#define EHMTX_LOG(level, log, tag, ...)                                                       \
+  do                                                                                          \
+  {                                                                                           \
+    if ((ESPHOME_LOG_LEVEL >= level) && !esphome::EHMTX_defer_log(level, tag, __VA_ARGS__)) \
+    {                                                                                         \
+      log(tag, __VA_ARGS__);                                                                  \
+    }                                                                                         \
+  } while (0)
+#undef ESP_LOGE
+#undef ESP_LOGW
+#undef ESP_LOGI
+#undef ESP_LOGD
+#undef ESP_LOGV
+#define ESP_LOGE(tag, ...) EHMTX_LOG(ESPHOME_LOG_LEVEL_ERROR, esph_log_e, tag, __VA_ARGS__)
+#define ESP_LOGW(tag, ...) EHMTX_LOG(ESPHOME_LOG_LEVEL_WARN, esph_log_w, tag, __VA_ARGS__)
+#define ESP_LOGI(tag, ...) EHMTX_LOG(ESPHOME_LOG_LEVEL_INFO, esph_log_i, tag, __VA_ARGS__)
+#define ESP_LOGD(tag, ...) EHMTX_LOG(ESPHOME_LOG_LEVEL_DEBUG, esph_log_d, tag, __VA_ARGS__)
+#define ESP_LOGV(tag, ...) EHMTX_LOG(ESPHOME_LOG_LEVEL_VERBOSE, esph_log_v, tag, __VA_ARGS__)
+#endif
+
 namespace esphome
 {
+  class EHMTX;
   class EHMTX_queue;
   class EHMTX_Icon;
   class EHMTXNextScreenTrigger;
@@ -55,6 +198,389 @@ namespace esphome
   class EHMTXExpiredScreenTrigger;
   class EHMTXNextClockTrigger;
   class EHMTXStartRunningTrigger;
+  class EHMTXTimerDoneTrigger;
+
+  // the bitmap services send RGB565, the low bits stay 0 like the colors the services always drew
+  inline Color rgb565_color(uint16_t c) { return Color((c & 0xF800) >> 8, (c & 0x07E0) >> 3, (c & 0x001F) << 3); }
+
+  struct EHMTX_Glyph
+  {
+    int16_t glyph; // index into the font glyph table, -1 for unknown chars
+    int16_t x;     // pen position relative to the start of the run
+  };
+
+  // a [#rrggbb] or [/] tag, the glyphs from first on are drawn in color or in the color of the screen
+  struct EHMTX_Span
+  {
+    uint16_t first;
+    bool custom;
+    Color color;
+  };
+
+  // an [icon:name] tag, drawn at x like a glyph
+  struct EHMTX_InlineIcon
+  {
+    int16_t x;
+    uint8_t icon;
+  };
+
+  class EHMTX_TextRun
+  {
+  public:
+    std::vector<EHMTX_Glyph> glyphs;
+    std::vector<EHMTX_Span> spans;
+    std::vector<EHMTX_InlineIcon> icons;
+    uint16_t width = 0;
+
+    void shape(font::Font *font, const std::string &text, EHMTX *markup = nullptr);
+    void clear();
+  };
+
+  struct EHMTX_AtlasGlyph
+  {
+    uint16_t start; // first column in EHMTX_FontAtlas::columns
+    int8_t x;       // x offset of the first column to the pen position
+    uint8_t width;  // number of columns
+  };
+
+  // glyphs of a font pre-rendered for the 8 rows of the matrix, one byte per column, bit 0 = top row
+  class EHMTX_FontAtlas
+  {
+  public:
+    std::vector<EHMTX_AtlasGlyph> glyphs;
+    std::vector<uint8_t> columns;
+    uint8_t unknown_column = 0; // box drawn for chars without glyph
+    uint8_t unknown_width = 0;
+    int8_t min_x = 0;
+
+    void bake(font::Font *font, int8_t yoffset);
+    void draw(display::DisplayBuffer *display, const EHMTX_TextRun &run, int x, Color color);
+  };
+
+  // durations since the last reset, log scale buckets so p50/p95 are within 1/4 of a power of two
+  class EHMTX_Histogram
+  {
+  public:
+    uint32_t count = 0;
+    uint32_t max = 0;
+
+    void add(uint32_t us);
+    uint32_t percentile(uint8_t p);
+    void reset();
+
+  protected:
+    uint16_t buckets_[STATS_BUCKETS] = {0};
+  };
+
+  struct EHMTX_LayerPixel
+  {
+    uint8_t x;
+    uint8_t y;
+    Color color;
+  };
+
+  // pixels of an overlay, rebuilt only after the overlay changed
+  class EHMTX_Layer
+  {
+  public:
+    std::vector<EHMTX_LayerPixel> pixels;
+    bool dirty = true;
+    bool active = false; // something to show, a hidden layer can still hide others
+
+    void clear();
+    void pixel(int x, int y, Color color);
+    void line(int x1, int y1, int x2, int y2, Color color);
+    void draw(display::DisplayBuffer *display);
+  };
+
+  // texts of the ticker screen, appended on the right and dropped on the left once they scrolled out,
+  // a segment starts at start pixels from the ticker start and is drawn at MATRIX_WIDTH + start - offset
+  class EHMTX_Ticker
+  {
+  public:
+    uint32_t dropped = 0; // segments dropped because the ring was full
+
+    bool empty() const { return this->count_ == 0; }
+    uint8_t size() const { return this->count_; }
+    void set_font(font::Font *font, EHMTX_FontAtlas *atlas, int8_t xoffset);
+    void append(const std::string &text, Color color);
+    void clear();
+    void scroll(uint32_t since);
+    void draw(display::DisplayBuffer *display);
+
+  protected:
+    struct Segment
+    {
+      EHMTX_TextRun run;
+      int32_t start;
+      Color color;
+    };
+    Segment segments_[TICKER_SEGMENTS]; // the glyph vectors are reused, appending allocates only for longer texts
+    uint8_t first_ = 0;
+    uint8_t count_ = 0;
+    int32_t offset_ = 0;      // pixels scrolled, the first segment starts at 0 after a drop
+    uint32_t last_step_ = 0;  // millis() of the last scroll step
+    font::Font *font_ = nullptr;
+    EHMTX_FontAtlas *atlas_ = nullptr;
+    int8_t xoffset_ = 0;      // default_xoffset or special_xoffset of the font
+
+    void drop();
+  };
+
+  // samples of a graph screen in a ring, the newest one in the right column, scaled to the samples kept.
+  // every sample has its column like EHMTX_FontAtlas::columns, an append computes only the new column
+  // unless the range changes, the older columns move left with the ring
+  class EHMTX_Graph
+  {
+  public:
+    std::string name;
+    uint32_t updated = 0; // millis() of the last append
+    uint32_t rescales = 0; // appends that changed the range and computed all columns
+
+    bool empty() const { return this->count_ == 0; }
+    uint8_t size() const { return this->count_; }
+    float min() const { return this->min_; }
+    float max() const { return this->max_; }
+    void clear();
+    void set_width(uint8_t width);
+    void set_line(bool line);
+    void append(float value);
+    void draw(display::DisplayBuffer *display, int left, Color color);
+
+  protected:
+    float samples_[MATRIX_WIDTH];
+    uint8_t columns_[MATRIX_WIDTH]; // bit 0 = top row
+    uint8_t first_ = 0;
+    uint8_t count_ = 0;
+    uint8_t width_ = MATRIX_WIDTH;
+    bool line_ = false;
+    float min_ = 0;
+    float max_ = 0;
+
+    uint8_t row(float value);
+    uint8_t column(uint8_t i);
+    void scale();
+    void drop();
+  };
+
+  // 12 bytes, the strings are looked up when the ring is dumped
+  struct EHMTX_DiagRecord
+  {
+    uint32_t ms;
+    uint8_t event;
+    uint8_t slot;
+    uint8_t mode;
+    uint8_t icon;
+    uint16_t value;
+    uint16_t value2;
+  };
+
+  struct EHMTX_Event
+  {
+    uint8_t type = EVENT_NEXT_SCREEN;
+    uint8_t mode = MODE_EMPTY;
+    std::string icon_name;
+    std::string text;
+  };
+
+  // lock-free ring for one producer and one consumer task, N must be a power of two
+  template <typename T, uint16_t N>
+  class EHMTX_Ring
+  {
+  public:
+    // producer, false when full
+    bool push(T &&item)
+    {
+      uint16_t head = this->head_.load(std::memory_order_relaxed);
+      if ((uint16_t)(head - this->tail_.load(std::memory_order_acquire)) == N)
+      {
+        return false;
+      }
+      this->items_[head & (N - 1)] = std::move(item);
+      this->head_.store(head + 1, std::memory_order_release);
+      return true;
+    }
+
+    // consumer, false when empty
+    bool pop(T &item)
+    {
+      uint16_t tail = this->tail_.load(std::memory_order_relaxed);
+      if (tail == this->head_.load(std::memory_order_acquire))
+      {
+        return false;
+      }
+      item = std::move(this->items_[tail & (N - 1)]);
+      this->tail_.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    uint16_t size() const { return this->head_.load(std::memory_order_acquire) - this->tail_.load(std::memory_order_acquire); }
+
+  protected:
+    static_assert((N & (N - 1)) == 0, "EHMTX_Ring size must be a power of two");
+    T items_[N];
+    std::atomic<uint16_t> head_{0}; // written by the producer only
+    std::atomic<uint16_t> tail_{0}; // written by the consumer only
+  };
+
+#ifdef EHMTXv2_RENDER_TASK
+  // a queued service call, the callable with its arguments lives in the slot so queueing does not allocate
+  class EHMTX_Command
+  {
+  public:
+    EHMTX_Command() = default;
+    EHMTX_Command(const EHMTX_Command &) = delete;
+    EHMTX_Command &operator=(const EHMTX_Command &) = delete;
+
+    template <typename F>
+    explicit EHMTX_Command(F &&f)
+    {
+      using C = typename std::decay<F>::type;
+      static_assert(sizeof(C) <= COMMAND_SIZE, "arguments too large for COMMAND_SIZE");
+      static_assert(alignof(C) <= alignof(std::max_align_t), "arguments over-aligned");
+      new (this->storage_) C(std::forward<F>(f));
+      this->ops_ = &Ops<C>::OPS;
+    }
+
+    EHMTX_Command(EHMTX_Command &&other) { *this = std::move(other); }
+
+    EHMTX_Command &operator=(EHMTX_Command &&other)
+    {
+      if (this != &other)
+      {
+        this->reset();
+        if (other.ops_ != nullptr)
+        {
+          other.ops_->move(this->storage_, other.storage_);
+          this->ops_ = other.ops_;
+          other.reset();
+        }
+      }
+      return *this;
+    }
+
+    ~EHMTX_Command() { this->reset(); }
+
+    void operator()() { this->ops_->call(this->storage_); }
+
+  protected:
+    struct Table
+    {
+      void (*call)(void *storage);
+      void (*move)(void *to, void *from);
+      void (*destroy)(void *storage);
+    };
+
+    template <typename C>
+    struct Ops
+    {
+      static void call(void *storage) { (*(C *)storage)(); }
+      static void move(void *to, void *from) { new (to) C(std::move(*(C *)from)); }
+      static void destroy(void *storage) { ((C *)storage)->~C(); }
+      static constexpr Table OPS = {call, move, destroy};
+    };
+
+    void reset()
+    {
+      if (this->ops_ != nullptr)
+      {
+        this->ops_->destroy(this->storage_);
+        this->ops_ = nullptr;
+      }
+    }
+
+    alignas(std::max_align_t) uint8_t storage_[COMMAND_SIZE];
+    const Table *ops_ = nullptr;
+  };
+
+  // frames of the render task: it draws into back_ while the display shows front_, ready_ holds the newest frame
+  class EHMTX_FrameBuffer : public display::DisplayBuffer
+  {
+  public:
+    void begin_frame();
+    void publish();
+    void show(display::DisplayBuffer *display);
+    display::DisplayType get_display_type() override { return display::DisplayType::DISPLAY_TYPE_COLOR; }
+
+  protected:
+    static const uint8_t FRESH = 4; // flag in ready_, the frame was not shown yet
+    void draw_absolute_pixel_internal(int x, int y, Color color) override;
+    int get_width_internal() override { return MATRIX_WIDTH; }
+    int get_height_internal() override { return MATRIX_HEIGHT; }
+    Color pixels_[3][MATRIX_PIXELS];
+    uint8_t back_ = 0;
+    uint8_t front_ = 1;
+    std::atomic<uint8_t> ready_{2};
+  };
+
+  // the newest value the render task wrote for the main loop, handed over like the frames: the task fills back()
+  // and publishes it, the loop gets every published value once from fresh()
+  template <typename T>
+  class EHMTX_Handover
+  {
+  public:
+    T *back() { return &this->items_[this->back_]; }
+
+    void publish()
+    {
+      this->back_ = this->ready_.exchange(this->back_ | FRESH, std::memory_order_acq_rel) & ~FRESH;
+    }
+
+    T *fresh()
+    {
+      if (!(this->ready_.load(std::memory_order_acquire) & FRESH))
+      {
+        return nullptr;
+      }
+      this->front_ = this->ready_.exchange(this->front_, std::memory_order_acq_rel) & ~FRESH;
+      return &this->items_[this->front_];
+    }
+
+  protected:
+    static const uint8_t FRESH = 4;
+    T items_[3];
+    uint8_t back_ = 0;
+    uint8_t front_ = 1;
+    std::atomic<uint8_t> ready_{2};
+  };
+#endif
+
+#ifdef EHMTXv2_STATS
+  // the values of the stat sensors for one stats_interval, in stat_sensor order
+  struct EHMTX_Stats
+  {
+    float values[STAT_COUNT];
+  };
+#endif
+
+#ifdef EHMTXv2_PERSIST_SIZE
+  // the serialized queue as it is stored in the preferences, see EHMTX_persist.cpp for the layout
+  struct EHMTX_Snapshot
+  {
+    uint8_t data[EHMTXv2_PERSIST_SIZE];
+  };
+#endif
+
+#ifdef EHMTXv2_FRAME_CACHE
+  // RAM copy of the rgb565 frames of the current and the next icon, each one gets half of the buffer
+  class EHMTX_FrameCache
+  {
+  public:
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+
+    int8_t slot_of(uint8_t icon);
+    void fill(uint8_t slot, uint8_t icon, EHMTX_Icon *image);
+    const uint16_t *frame(uint8_t icon, int frame);
+
+  protected:
+    static const uint32_t SLOT_SIZE = EHMTXv2_FRAME_CACHE / 4; // pixels per slot
+    uint16_t data_[2 * SLOT_SIZE];
+    uint8_t icon_[2] = {MAXICONS, MAXICONS};
+    uint16_t frames_[2] = {0, 0};
+    uint16_t pixels_[2] = {0, 0};
+  };
+#endif
 
   class EHMTX : public PollingComponent, public api::CustomAPIDevice
   {
@@ -71,8 +597,83 @@ namespace esphome
     std::vector<EHMTXNextClockTrigger *> on_next_clock_triggers_;
     std::vector<EHMTXStartRunningTrigger *> on_start_running_triggers_;
     std::vector<EHMTXAddScreenTrigger *> on_add_screen_triggers_;
+    std::vector<EHMTXTimerDoneTrigger *> on_timer_done_triggers_;
     EHMTX_queue *find_icon_queue_element(uint8_t icon);
     EHMTX_queue *find_free_queue_element();
+#ifdef EHMTXv2_RENDER_TASK
+    EHMTX_FrameBuffer *frame_buffer_ = nullptr;
+    EHMTX_Ring<EHMTX_Command, COMMAND_QUEUE> commands_;
+    TaskHandle_t render_task_ = nullptr;
+    std::atomic<float> correction_{-1.0f}; // brightness for loop() to apply, below 0 when there is none
+
+    void start_render_task();
+    static void render_task(void *arg);
+    void render_frame();
+    bool in_render_task();
+    template <typename M, typename T, size_t... I>
+    void call(M method, T &args, std::index_sequence<I...>)
+    {
+      (this->*method)(std::move(std::get<I>(args))...);
+    }
+#endif
+    EHMTX_Ring<EHMTX_Event, EVENT_QUEUE> events_; // written by tick() and the services, read by loop()
+    EHMTX_Event batch_[EVENT_QUEUE];
+    bool has_triggers(uint8_t type);
+    void queue_event(uint8_t type, const std::string &icon_name, const std::string &text, uint8_t mode = MODE_EMPTY);
+    void dispatch_event(const EHMTX_Event &event);
+
+    uint32_t last_frame_start_ = 0;
+    uint32_t screen_start_ = 0;
+    uint32_t last_millis_ = 0;  // millis() of the last uptime() call
+    uint32_t millis_wraps_ = 0; // millis() overflows since boot
+    bool time_synced_ = false;
+#ifdef EHMTXv2_DIAG_SIZE
+    EHMTX_DiagRecord diag_[EHMTXv2_DIAG_SIZE];
+    uint32_t diag_count_ = 0; // records since boot, the last EHMTXv2_DIAG_SIZE are kept
+#endif
+#ifdef EHMTXv2_TRACE_SIZE
+    char trace_[EHMTXv2_TRACE_SIZE];
+    uint32_t trace_head_ = 0; // oldest record
+    uint32_t trace_used_ = 0;
+    uint32_t trace_dropped_ = 0;
+#endif
+#ifdef EHMTXv2_STATS
+    uint32_t last_stats_time_ = 0;
+    uint32_t stats_interval_ = 60000;
+#ifdef EHMTXv2_RENDER_TASK
+    EHMTX_Handover<EHMTX_Stats> stats_; // taken by the render task and published by the main loop
+#else
+    EHMTX_Stats stats_;
+    bool stats_fresh_ = false;
+#endif
+#endif
+#ifdef EHMTXv2_PERSIST_SIZE
+    ESPPreferenceObject persist_pref_;
+#ifdef EHMTXv2_RENDER_TASK
+    EHMTX_Handover<EHMTX_Snapshot> snapshots_; // written by the render task and saved by the main loop
+#else
+    EHMTX_Snapshot snapshots_[1];
+    bool snapshot_fresh_ = false;
+#endif
+    bool persist_dirty_ = false;   // a service ran since the last snapshot
+    uint32_t persist_changed_ = 0; // millis() of that service call
+    EHMTX_Snapshot *persist_unsaved_ = nullptr; // taken by the main loop, not written yet
+    EHMTX_Snapshot persist_stored_; // copy of the snapshot in the preferences
+    bool persist_has_stored_ = false;
+    uint32_t persist_saved_ = 0;    // millis() of the last write
+    uint32_t persist_interval_ = 60000;
+    uint32_t persist_time_ = 0;     // clock time of the restored snapshot while the time off is unknown
+    time_t persist_restored_ = 0;   // uptime() of the restore
+
+    EHMTX_Snapshot *snapshot_back();
+    void publish_snapshot();
+    EHMTX_Snapshot *fresh_snapshot();
+    uint16_t write_snapshot(uint8_t *data);
+    uint8_t read_snapshot(const uint8_t *data);
+#endif
+#if defined(EHMTXv2_STATS) && defined(USE_SENSOR)
+    sensor::Sensor *stat_sensors_[STAT_COUNT] = {nullptr};
+#endif
 
   public:
     void setup() override;
@@ -82,19 +683,21 @@ namespace esphome
     void dump_config();
 #ifdef USE_ESP32
     PROGMEM Color text_color, alarm_color, rindicator_color,  lindicator_color, today_color, weekday_color, rainbow_color, clock_color;
-    PROGMEM Color bitmap[256];
-    PROGMEM Color sbitmap[64];
-    PROGMEM Color cgauge[8];
     PROGMEM EHMTX_Icon *icons[MAXICONS];
 #endif
 
 #ifdef USE_ESP8266
-    Color text_color, alarm_color, gauge_color, gauge_bgcolor,rindicator_color,lindicator_color, today_color, weekday_color, rainbow_color, clock_color;
+    Color text_color, alarm_color, rindicator_color,lindicator_color, today_color, weekday_color, rainbow_color, clock_color;
     EHMTX_Icon *icons[MAXICONS];
-    uint8_t gauge_value;
 #endif
-    display::BaseFont *default_font;
-    display::BaseFont *special_font;
+    Color cgauge[8];
+    // RGB565 as the services get them, expanded with rgb565_color() when drawn
+    uint16_t bitmap[MATRIX_PIXELS];
+    uint16_t sbitmap[64];
+    font::Font *default_font;
+    font::Font *special_font;
+    EHMTX_FontAtlas *default_atlas;
+    EHMTX_FontAtlas *special_atlas;
     int display_rindicator;
     int display_lindicator;
     int display_alarm;
@@ -108,6 +711,7 @@ namespace esphome
 
     EHMTX_queue *queue[MAXQUEUE];
     addressable_light::AddressableLightDisplay *display;
+    display::DisplayBuffer *target; // frames are drawn here, the display or the frame buffer of the render task
     esphome::time::RealTimeClock *clock;
 
     bool show_seconds;
@@ -115,18 +719,56 @@ namespace esphome
     uint8_t icon_count; // max iconnumber -1
     unsigned long last_scroll_time;
     unsigned long last_rainbow_time;
-    unsigned long last_anim_time;
     time_t next_action_time = 0; // when is the next screen change
     uint32_t tick_next_action = 0; // when is the next screen change
     uint32_t ticks_ = 0; // when is the next screen change
+    time_t uptime();     // seconds since boot, the time base of the queue
+    void time_synced();
+
+#ifdef EHMTXv2_STATS
+    EHMTX_Histogram tick_time;
+    EHMTX_Histogram draw_time;
+    EHMTX_Histogram service_time;
+#endif
+    uint32_t late_frames = 0;
+    uint32_t dropped_frames = 0;
+    const char *slowest_service = "";
+    uint32_t slowest_service_time = 0;
+    uint8_t service_depth = 0;
+
+#ifdef EHMTXv2_STATS
+    EHMTX_Histogram wait_time;  // ms from adding a screen to its first display
+    EHMTX_Histogram dwell_time; // ms a screen was displayed
+#endif
+    uint32_t queue_inserts = 0;
+    uint32_t queue_updates = 0;
+    uint32_t queue_evictions = 0;
+    uint32_t queue_expiries = 0;
+    uint32_t forced_screens = 0;
+    uint32_t skipped_screens = 0;
+    uint8_t queue_peak = 0;
+    uint32_t dropped_commands = 0; // service calls lost because the command queue was full
+    uint32_t dropped_events = 0;   // trigger events lost because the event queue was full
+    uint32_t coalesced_events = 0; // trigger events superseded by a later one before loop() ran
+#ifdef EHMTXv2_PERSIST_SIZE
+    uint32_t persist_writes = 0;  // snapshots written to the preferences since boot
+    uint8_t restored_screens = 0; // screens restored by setup()
+#endif
+#ifdef EHMTXv2_COUNT_ALLOCATIONS
+    uint32_t frame_allocations = 0;   // heap allocations in tick() and draw()
+    uint32_t service_allocations = 0; // heap allocations in the services, without their arguments
+#endif
+#ifdef EHMTXv2_FRAME_CACHE
+    EHMTX_FrameCache frame_cache;
+#endif
 
     void remove_expired_queue_element();
     uint8_t find_oldest_queue_element();
-    uint8_t find_icon_in_queue(std::string);
+    uint8_t find_icon_in_queue(const std::string &name);
     void force_screen(std::string name, int mode = MODE_ICON_SCREEN);
     void add_icon(EHMTX_Icon *icon);
     bool show_display = false;
-    uint8_t find_icon(std::string name);
+    uint8_t find_icon(const std::string &name, bool warn = true); // MAXICONS when there is none
     uint8_t find_last_clock();
     bool string_has_ending(std::string const &fullString, std::string const &ending);
     void draw_day_of_week();
@@ -135,6 +777,53 @@ namespace esphome
     void draw();
     void get_status();
     void queue_status();
+    void stats_status();
+#ifdef EHMTXv2_STATS
+    void take_stats();
+    void publish_stats();
+    void set_stats_interval(uint32_t ms);
+#endif
+    void set_correction(float brightness);
+    void frame_started(uint32_t now);
+    uint8_t queue_occupied();
+    void queue_inserted(EHMTX_queue *screen);
+    void screen_started(uint8_t previous);
+    void draw_icon(int x, int y, uint8_t icon);
+#ifdef EHMTXv2_FRAME_CACHE
+    uint8_t queue_icon(uint8_t slot);
+    void prefetch_frames();
+    float frame_cache_hit_rate();
+#endif
+#ifdef EHMTXv2_TRACE_SIZE
+    void trace_append(const std::string &record);
+    void dump_trace();
+    void clear_trace();
+#endif
+#ifdef EHMTXv2_DIAG_SIZE
+    void dump_diag();
+    void clear_diag();
+#endif
+#ifdef EHMTXv2_PERSIST_SIZE
+    void restore_queue();
+    void rebase_restored();
+    void persist_changed();
+    void take_snapshot(bool force = false);
+    void save_snapshot(bool force = false);
+    void set_persist_interval(uint32_t ms);
+    void on_safe_shutdown() override;
+#endif
+
+    // a binary record in the diag ring instead of a debug log line, nothing without diag_size
+    void diag(uint8_t event, uint8_t slot, uint8_t mode = MODE_EMPTY, uint8_t icon = MAXICONS, uint16_t value = 0, uint16_t value2 = 0)
+    {
+#ifdef EHMTXv2_DIAG_SIZE
+      this->diag_[this->diag_count_ % EHMTXv2_DIAG_SIZE] = {millis(), event, slot, mode, icon, value, value2};
+      this->diag_count_++;
+#endif
+    }
+#if defined(EHMTXv2_STATS) && defined(USE_SENSOR)
+    void set_stat_sensor(uint8_t stat, sensor::Sensor *sensor);
+#endif
     void skip_screen();
     void hold_screen(int t = 30);
     void set_display(addressable_light::AddressableLightDisplay *disp);
@@ -146,8 +835,8 @@ namespace esphome
     void set_display_on();
     void set_display_off();
     void set_clock(esphome::time::RealTimeClock *clock);
-    void set_default_font(display::BaseFont *font);
-    void set_special_font(display::BaseFont *font);
+    void set_default_font(font::Font *font);
+    void set_special_font(font::Font *font);
     void show_rindicator(int r = C_RED, int g = C_GREEN, int b = C_BLUE, int s = 3);
     void show_lindicator(int r = C_RED, int g = C_GREEN, int b = C_BLUE, int s = 3);
     void set_today_color(int r, int g, int b);
@@ -175,10 +864,32 @@ namespace esphome
     void rainbow_date_screen(int lifetime = D_LIFETIME, int screen_time = D_SCREEN_TIME, bool default_font = true);
     void del_screen(std::string icon, int mode = MODE_ICON_SCREEN);
 
-    void draw_gauge();
-    void draw_alarm();
-    void draw_rindicator();
-    void draw_lindicator();
+    EHMTX_Ticker ticker;
+    EHMTX_queue *find_ticker();
+    void ticker_screen(std::string text, int lifetime = D_LIFETIME, int screen_time = D_SCREEN_TIME, bool default_font = true, int r = C_RED, int g = C_GREEN, int b = C_BLUE);
+    void ticker_append(std::string text);
+
+    EHMTX_Graph graphs[GRAPHS];
+    uint8_t find_graph(const std::string &name);
+    EHMTX_queue *find_graph_screen(const std::string &name);
+    void graph_screen(std::string name, int lifetime = D_LIFETIME, int screen_time = D_SCREEN_TIME, bool line = false, int r = C_RED, int g = C_GREEN, int b = C_BLUE);
+    void graph_append(std::string name, float value);
+
+    EHMTX_queue *find_timer_queue_element(const std::string &icon_name);
+    void add_timer(std::string icon_name, uint32_t ms, bool up, int lifetime, int screen_time, bool default_font, Color color);
+    void timer_screen(std::string icon_name, int seconds, int lifetime = D_LIFETIME, int screen_time = D_SCREEN_TIME, bool default_font = true, int r = C_RED, int g = C_GREEN, int b = C_BLUE);
+    void timer_until(std::string icon_name, int timestamp, int lifetime = D_LIFETIME, int screen_time = D_SCREEN_TIME, bool default_font = true, int r = C_RED, int g = C_GREEN, int b = C_BLUE);
+    void check_timers();
+
+    EHMTX_Layer layers[LAYER_COUNT];
+    void layer_changed(uint8_t layer);
+    bool layer_visible(uint8_t layer, uint8_t mode);
+    void draw_layers(uint8_t mode);
+    void render_layer(uint8_t layer);
+    void render_gauge(EHMTX_Layer *layer);
+    void render_alarm(EHMTX_Layer *layer);
+    void render_rindicator(EHMTX_Layer *layer);
+    void render_lindicator(EHMTX_Layer *layer);
 
     void add_on_next_screen_trigger(EHMTXNextScreenTrigger *t) { this->on_next_screen_triggers_.push_back(t); }
     void add_on_add_screen_trigger(EHMTXAddScreenTrigger *t) { this->on_add_screen_triggers_.push_back(t); }
@@ -186,21 +897,93 @@ namespace esphome
     void add_on_expired_screen_trigger(EHMTXExpiredScreenTrigger *t) { this->on_expired_screen_triggers_.push_back(t); }
     void add_on_next_clock_trigger(EHMTXNextClockTrigger *t) { this->on_next_clock_triggers_.push_back(t); }
     void add_on_start_running_trigger(EHMTXStartRunningTrigger *t) { this->on_start_running_triggers_.push_back(t); }
-#ifndef USE_ESP8266
-  #ifdef EHMTXv2_BOOTLOGO
+    void add_on_timer_done_trigger(EHMTXTimerDoneTrigger *t) { this->on_timer_done_triggers_.push_back(t); }
+#ifdef EHMTXv2_BOOTLOGO
     void display_boot_logo();
     void display_version();
-  #endif
 #endif
 
     void update();
     uint8_t get_brightness();
+    void loop() override;
+
+    // true when the call was queued for the render task, the caller returns and the call runs again there,
+    // the arguments are moved into the command and from there into the call
+    template <typename... Ts, typename... As>
+    bool post(void (EHMTX::*method)(Ts...), As &&...args)
+    {
+#ifdef EHMTXv2_RENDER_TASK
+      if ((this->render_task_ != nullptr) && !this->in_render_task())
+      {
+        if (!this->commands_.push(EHMTX_Command([this, method, args = std::make_tuple(std::forward<As>(args)...)]() mutable
+                                                { this->call(method, args, std::index_sequence_for<As...>()); })))
+        {
+          this->dropped_commands++;
+          ESP_LOGW(TAG, "command queue full, call dropped");
+        }
+        return true;
+      }
+#endif
+      return false;
+    }
+  };
+
+  // what a screen type does once when it is added and on every frame, see EHMTX_screens.cpp
+  struct EHMTX_ScreenType
+  {
+    const char *name;
+    uint8_t flags;
+    void (EHMTX_queue::*prepare)(uint16_t screen_time);
+    void (EHMTX_queue::*render)();
+    bool (EHMTX_queue::*showable)(); // nullptr when the screen always has something to show
+    void (EHMTX_queue::*status)();   // nullptr for the queue line the flags describe
   };
 
   class EHMTX_queue
   {
   protected:
     EHMTX *config_;
+    font::Font *font_;
+    EHMTX_FontAtlas *atlas_;
+    int8_t xoffset_;
+    int8_t yoffset_;
+    int16_t text_x_[2];   // x of the text at scroll_step 0 without and with gauge
+    int8_t scroll_dir_[2]; // -1 right to left, 0 not scrolling, 1 left to right
+    time_t shaped_time_;  // timestamp of the time in run
+    char timer_text_[12]; // shown in run, only the chars that change are looked up again
+    uint8_t digit_width_; // a timer puts every digit in a cell of this width, the others keep their place
+
+    static const EHMTX_ScreenType TYPES[MODE_COUNT];
+
+    void prepare_static(uint16_t screen_time);
+    void prepare_time(uint16_t screen_time);
+    template <uint8_t STARTX>
+    void prepare_text(uint16_t screen_time);
+    void render_none();
+    void render_full();
+    template <bool RAINBOW>
+    void render_icon();
+    template <bool RAINBOW>
+    void render_text();
+    template <bool RAINBOW, bool DATE>
+    void render_time();
+    void render_bitmap();
+    void render_bitmap_small();
+    void prepare_ticker(uint16_t screen_time);
+    void render_ticker();
+    bool showable_ticker();
+    void status_ticker();
+    void prepare_graph(uint16_t screen_time);
+    void render_graph();
+    bool showable_graph();
+    void status_graph();
+    void prepare_timer(uint16_t screen_time);
+    void render_timer();
+    void status_timer();
+    void layout_timer(const char *text);
+    void timer_text(char *buffer, size_t size);
+    void draw_text(Color color);
+    void draw_time(const char *format, Color color);
 
   public:
     uint16_t pixels_;
@@ -212,6 +995,15 @@ namespace esphome
     uint16_t scroll_reset;
     Color text_color;
     show_mode mode;
+    uint32_t added_time; // millis() when the screen was added or updated
+    bool waiting;        // not displayed since added_time
+    uint32_t anim_start; // millis() when the screen was displayed, the icon animation starts there
+    uint8_t slot;        // index in EHMTX::queue
+    bool restored;       // from the persisted snapshot and not replaced since
+    uint8_t graph;       // index in EHMTX::graphs of a graph screen
+    uint32_t timer_ms;   // millis() a timer ends at, or started at when it counts up
+    bool timer_up;       // the timer is a stopwatch
+    bool timer_done;     // the countdown reached zero and on_timer_done was queued
 
 #ifdef USE_ESP32
     PROGMEM std::string text;
@@ -222,40 +1014,99 @@ namespace esphome
     std::string icon_name;
 #endif
 
-    EHMTX_queue(EHMTX *config);
+    EHMTX_TextRun run;
 
+    EHMTX_queue(EHMTX *config, uint8_t slot);
+
+    static const char *mode_name(uint8_t mode);
+    static uint8_t mode_flags(uint8_t mode);
     void status();
+    void diag(uint8_t event);
     void draw();
     bool isfree();
     bool update_slot(uint8_t _icon);
     void update_screen();
+    void select_frame();
     void hold_slot(uint8_t _sec);
-    void calc_scroll_time(std::string, uint16_t);
-    int xpos();
+    void prepare(uint16_t screen_time);
+    bool shows_icon();
+    bool needs_time();
+    bool showable();
+    EHMTX_Graph *graph_samples();
+  };
+
+  // measures a service call into EHMTX::service_time, nested calls count for the outer one
+  // name nullptr marks screens the component adds by itself, they are neither measured nor traced
+  class EHMTX_ServiceTimer
+  {
+  public:
+    EHMTX_ServiceTimer(EHMTX *config, const char *name);
+    ~EHMTX_ServiceTimer();
+
+    // record the call with its arguments for a replay, only the outermost call
+    template <typename... Ts>
+    void trace(const Ts &...args)
+    {
+#ifdef EHMTXv2_TRACE_SIZE
+      if (!this->outer_)
+      {
+        return;
+      }
+      std::string record = "[" + std::to_string(millis()) + "," + std::to_string((int64_t)this->config_->clock->now().timestamp) + ",";
+      trace_arg(record, std::string(this->name_));
+      this->trace_args(record, args...);
+      record += "]";
+      this->config_->trace_append(record);
+#endif
+    }
+
+  protected:
+    EHMTX *config_;
+    const char *name_;
+    uint32_t start_;
+    bool outer_;
+#ifdef EHMTXv2_COUNT_ALLOCATIONS
+    uint32_t allocations_;
+#endif
+
+#ifdef EHMTXv2_TRACE_SIZE
+    static void trace_arg(std::string &record, const std::string &value);
+    static void trace_arg(std::string &record, int value);
+    static void trace_arg(std::string &record, bool value);
+    static void trace_arg(std::string &record, float value);
+    void trace_args(std::string &record) {}
+    template <typename T, typename... Ts>
+    void trace_args(std::string &record, const T &value, const Ts &...args)
+    {
+      record += ",";
+      trace_arg(record, value);
+      this->trace_args(record, args...);
+    }
+#endif
   };
 
   class EHMTXNextScreenTrigger : public Trigger<std::string, std::string>
   {
   public:
     explicit EHMTXNextScreenTrigger(EHMTX *parent) { parent->add_on_next_screen_trigger(this); }
-    void process(std::string, std::string);
+    void process(const std::string &, const std::string &);
   };
 
   class EHMTXAddScreenTrigger : public Trigger<std::string, uint8_t>
   {
   public:
     explicit EHMTXAddScreenTrigger(EHMTX *parent) { parent->add_on_add_screen_trigger(this); }
-    void process(std::string, uint8_t);
+    void process(const std::string &, uint8_t);
   };
 
   class EHMTXIconErrorTrigger : public Trigger<std::string>
   {
   public:
     explicit EHMTXIconErrorTrigger(EHMTX *parent) { parent->add_on_icon_error_trigger(this); }
-    void process(std::string);
+    void process(const std::string &);
   };
 
- class EHMTXStartRunningTrigger : public Trigger<>
+  class EHMTXStartRunningTrigger : public Trigger<>
   {
   public:
     explicit EHMTXStartRunningTrigger(EHMTX *parent) { parent->add_on_start_running_trigger(this); }
@@ -266,7 +1117,14 @@ namespace esphome
   {
   public:
     explicit EHMTXExpiredScreenTrigger(EHMTX *parent) { parent->add_on_expired_screen_trigger(this); }
-    void process(std::string, std::string);
+    void process(const std::string &, const std::string &);
+  };
+
+  class EHMTXTimerDoneTrigger : public Trigger<std::string>
+  {
+  public:
+    explicit EHMTXTimerDoneTrigger(EHMTX *parent) { parent->add_on_timer_done_trigger(this); }
+    void process(const std::string &);
   };
 
   class EHMTXNextClockTrigger : public Trigger<>
@@ -279,13 +1137,17 @@ namespace esphome
   class EHMTX_Icon : public animation::Animation
   {
   protected:
-    bool counting_up;
+    const uint16_t *frame_durations_; // ms per frame in progmem, nullptr if all frames take frame_duration
+    uint32_t cycle_time_;              // ms for all frames, with pingpong forth and back
+
+    uint16_t get_frame_duration(int frame);
 
   public:
-    EHMTX_Icon(const uint8_t *data_start, int width, int height, uint32_t animation_frame_count, esphome::image::ImageType type, std::string icon_name, bool revers, uint16_t frame_duration);
+    EHMTX_Icon(const uint8_t *data_start, int width, int height, uint32_t animation_frame_count, esphome::image::ImageType type, std::string icon_name, bool revers, uint16_t frame_duration, const uint16_t *frame_durations = nullptr);
     std::string name;
     uint16_t frame_duration;
-    void next_frame();
+    int frame_at(uint32_t elapsed);
+    const uint8_t *get_frames_start() const { return this->animation_data_start_; }
     bool reverse;
   };
 }
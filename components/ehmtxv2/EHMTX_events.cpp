@@ -0,0 +1,175 @@
+#include "esphome.h"
+
+namespace esphome
+{
+  bool EHMTX::has_triggers(uint8_t type)
+  {
+    switch (type)
+    {
+    case EVENT_NEXT_SCREEN:
+      return !this->on_next_screen_triggers_.empty();
+    case EVENT_NEXT_CLOCK:
+      return !this->on_next_clock_triggers_.empty();
+    case EVENT_EXPIRED_SCREEN:
+      return !this->on_expired_screen_triggers_.empty();
+    case EVENT_ADD_SCREEN:
+      return !this->on_add_screen_triggers_.empty();
+    case EVENT_ICON_ERROR:
+      return !this->on_icon_error_triggers_.empty();
+    case EVENT_START_RUNNING:
+      return !this->on_start_running_triggers_.empty();
+    case EVENT_TIMER_DONE:
+      return !this->on_timer_done_triggers_.empty();
+    }
+    return false;
+  }
+
+  // called from tick() and the services, the automations run later in loop()
+  void EHMTX::queue_event(uint8_t type, const std::string &icon_name, const std::string &text, uint8_t mode)
+  {
+    if (!this->has_triggers(type))
+    {
+      return;
+    }
+    EHMTX_Event event;
+    event.type = type;
+    event.mode = mode;
+    event.icon_name = icon_name;
+    event.text = text;
+    if (!this->events_.push(std::move(event)))
+    {
+      this->dropped_events++;
+      ESP_LOGW(TAG, "event queue full, trigger dropped");
+    }
+  }
+
+  // only the last screen switch of a batch is reported, other events once if they repeat
+  static bool supersedes(const EHMTX_Event &later, const EHMTX_Event &event)
+  {
+    if ((event.type == EVENT_NEXT_SCREEN) || (event.type == EVENT_NEXT_CLOCK))
+    {
+      return (later.type == EVENT_NEXT_SCREEN) || (later.type == EVENT_NEXT_CLOCK);
+    }
+    return (later.type == event.type) && (later.mode == event.mode) && (later.icon_name == event.icon_name) &&
+           (later.text == event.text);
+  }
+
+  // main loop, after the frame is drawn
+  void EHMTX::loop()
+  {
+#ifdef EHMTXv2_RENDER_TASK
+    float correction = this->correction_.exchange(-1.0f, std::memory_order_acq_rel);
+    if (correction >= 0.0f)
+    {
+      this->display->get_light()->set_correction(correction, correction, correction);
+    }
+    EHMTX_flush_log();
+#endif
+    uint8_t count = 0;
+    while ((count < EVENT_QUEUE) && this->events_.pop(this->batch_[count]))
+    {
+      count++;
+    }
+    for (uint8_t i = 0; i < count; i++)
+    {
+      bool superseded = false;
+      for (uint8_t j = i + 1; (j < count) && !superseded; j++)
+      {
+        superseded = supersedes(this->batch_[j], this->batch_[i]);
+      }
+      if (superseded)
+      {
+        this->coalesced_events++;
+      }
+      else
+      {
+        this->dispatch_event(this->batch_[i]);
+      }
+    }
+  }
+
+  void EHMTX::dispatch_event(const EHMTX_Event &event)
+  {
+    switch (event.type)
+    {
+    case EVENT_NEXT_SCREEN:
+      for (auto *t : this->on_next_screen_triggers_)
+      {
+        t->process(event.icon_name, event.text);
+      }
+      break;
+    case EVENT_NEXT_CLOCK:
+      for (auto *t : this->on_next_clock_triggers_)
+      {
+        t->process();
+      }
+      break;
+    case EVENT_EXPIRED_SCREEN:
+      for (auto *t : this->on_expired_screen_triggers_)
+      {
+        t->process(event.icon_name, event.text);
+      }
+      break;
+    case EVENT_ADD_SCREEN:
+      for (auto *t : this->on_add_screen_triggers_)
+      {
+        t->process(event.icon_name, event.mode);
+      }
+      break;
+    case EVENT_ICON_ERROR:
+      for (auto *t : this->on_icon_error_triggers_)
+      {
+        t->process(event.icon_name);
+      }
+      break;
+    case EVENT_START_RUNNING:
+      for (auto *t : this->on_start_running_triggers_)
+      {
+        ESP_LOGD(TAG, "on_start_running_triggers");
+        t->process();
+      }
+      break;
+    case EVENT_TIMER_DONE:
+      for (auto *t : this->on_timer_done_triggers_)
+      {
+        t->process(event.icon_name);
+      }
+      break;
+    }
+  }
+
+  void EHMTXStartRunningTrigger::process()
+  {
+    this->trigger();
+  }
+
+  void EHMTXNextScreenTrigger::process(const std::string &iconname, const std::string &text)
+  {
+    this->trigger(iconname, text);
+  }
+
+  void EHMTXAddScreenTrigger::process(const std::string &iconname, uint8_t mode)
+  {
+    this->trigger(iconname, mode);
+  }
+
+  void EHMTXIconErrorTrigger::process(const std::string &iconname)
+  {
+    this->trigger(iconname);
+  }
+
+  void EHMTXExpiredScreenTrigger::process(const std::string &iconname, const std::string &text)
+  {
+    this->trigger(iconname, text);
+  }
+
+  void EHMTXNextClockTrigger::process()
+  {
+    this->trigger();
+  }
+
+  void EHMTXTimerDoneTrigger::process(const std::string &iconname)
+  {
+    this->trigger(iconname);
+  }
+}
@@ -0,0 +1,103 @@
+#include "esphome.h"
+
+namespace esphome
+{
+
+  // render every glyph once into the 8 matrix rows, yoffset is the baseline as in display->print()
+  void EHMTX_FontAtlas::bake(font::Font *font, int8_t yoffset)
+  {
+    int x1, y1, w, h;
+    int y_start = yoffset - font->get_baseline();
+
+    this->glyphs.clear();
+    this->columns.clear();
+    this->glyphs.reserve(font->get_glyphs().size());
+    this->min_x = 0;
+
+    for (auto &glyph : font->get_glyphs())
+    {
+      glyph.scan_area(&x1, &y1, &w, &h);
+      this->glyphs.push_back({(uint16_t)this->columns.size(), (int8_t)x1, (uint8_t)w});
+      for (int glyph_x = x1; glyph_x < x1 + w; glyph_x++)
+      {
+        uint8_t column = 0;
+        for (uint8_t row = 0; row < 8; row++)
+        {
+          if (glyph.get_pixel(glyph_x, row - y_start))
+          {
+            column |= 1 << row;
+          }
+        }
+        this->columns.push_back(column);
+      }
+      this->min_x = std::min(this->min_x, (int8_t)x1);
+    }
+    this->columns.shrink_to_fit();
+
+    this->unknown_column = 0;
+    this->unknown_width = 0;
+    if (!font->get_glyphs().empty())
+    {
+      font->get_glyphs()[0].scan_area(&x1, &y1, &w, &h);
+      this->unknown_width = w;
+      for (int row = std::max(y_start, 0); (row < 8) && (row < y_start + font->get_height()); row++)
+      {
+        this->unknown_column |= 1 << row;
+      }
+    }
+    ESP_LOGD(TAG, "font atlas: %d glyphs %d columns", (int)this->glyphs.size(), (int)this->columns.size());
+  }
+
+  // color is the color of the screen, the spans of the run change it from their first glyph on
+  void EHMTX_FontAtlas::draw(display::DisplayBuffer *display, const EHMTX_TextRun &run, int x, Color color)
+  {
+    int max_x = display->get_width();
+    Color current = color;
+    size_t span = 0;
+
+    for (size_t n = 0; n < run.glyphs.size(); n++)
+    {
+      const EHMTX_Glyph &g = run.glyphs[n];
+      while ((span < run.spans.size()) && (run.spans[span].first <= n))
+      {
+        current = run.spans[span].custom ? run.spans[span].color : color;
+        span++;
+      }
+      int x_at = x + g.x;
+      if (x_at + this->min_x >= max_x)
+      {
+        break;
+      }
+
+      const uint8_t *column = &this->unknown_column;
+      uint8_t width = this->unknown_width;
+      uint8_t step = 0;
+      if (g.glyph >= 0)
+      {
+        const EHMTX_AtlasGlyph &glyph = this->glyphs[g.glyph];
+        column = &this->columns[glyph.start];
+        width = glyph.width;
+        x_at += glyph.x;
+        step = 1;
+      }
+      if (x_at + width <= 0)
+      {
+        continue;
+      }
+
+      for (uint8_t c = 0; (c < width) && (x_at < max_x); c++, x_at++, column += step)
+      {
+        if (x_at < 0)
+        {
+          continue;
+        }
+        uint8_t bits = *column;
+        while (bits)
+        {
+          display->draw_pixel_at(x_at, __builtin_ctz(bits), current);
+          bits &= bits - 1;
+        }
+      }
+    }
+  }
+}
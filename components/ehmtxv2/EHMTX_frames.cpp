@@ -0,0 +1,124 @@
+#include "esphome.h"
+
+namespace esphome
+{
+#ifdef EHMTXv2_FRAME_CACHE
+  // the darkest green, display->image() leaves these pixels out when the image has transparency
+  static const uint16_t TRANSPARENT_RGB565 = 0x0020;
+#endif
+
+  void EHMTX::draw_icon(int x, int y, uint8_t icon)
+  {
+#ifdef EHMTXv2_FRAME_CACHE
+    EHMTX_Icon *image = this->icons[icon];
+    const uint16_t *frame = this->frame_cache.frame(icon, image->get_current_frame());
+    if (frame != nullptr)
+    {
+      const int width = image->get_width();
+      const int height = image->get_height();
+      const bool transparency = image->has_transparency();
+      for (int img_y = 0; img_y < height; img_y++)
+      {
+        for (int img_x = 0; img_x < width; img_x++)
+        {
+          uint16_t rgb565 = *frame++;
+          if (transparency && (rgb565 == TRANSPARENT_RGB565))
+          {
+            continue;
+          }
+          uint8_t r = rgb565 >> 11;
+          uint8_t g = (rgb565 >> 5) & 0x3F;
+          uint8_t b = rgb565 & 0x1F;
+          this->target->draw_pixel_at(x + img_x, y + img_y, Color((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2)));
+        }
+      }
+      return;
+    }
+#endif
+    this->target->image(x, y, this->icons[icon]);
+  }
+
+#ifdef EHMTXv2_FRAME_CACHE
+  int8_t EHMTX_FrameCache::slot_of(uint8_t icon)
+  {
+    for (uint8_t slot = 0; slot < 2; slot++)
+    {
+      if (this->icon_[slot] == icon)
+      {
+        return slot;
+      }
+    }
+    return -1;
+  }
+
+  // copies as many frames from flash as fit, the others are drawn from flash
+  void EHMTX_FrameCache::fill(uint8_t slot, uint8_t icon, EHMTX_Icon *image)
+  {
+    const uint16_t pixels = image->get_width() * image->get_height();
+    const uint16_t frames = std::min<uint32_t>(SLOT_SIZE / pixels, image->get_animation_frame_count());
+    const uint8_t *src = image->get_frames_start();
+    uint16_t *dest = this->data_ + slot * SLOT_SIZE;
+    for (uint32_t i = 0; i < (uint32_t)frames * pixels; i++)
+    {
+      dest[i] = (progmem_read_byte(src + 2 * i) << 8) | progmem_read_byte(src + 2 * i + 1);
+    }
+    this->icon_[slot] = icon;
+    this->frames_[slot] = frames;
+    this->pixels_[slot] = pixels;
+    ESP_LOGD(TAG, "frame cache: %d of %d frames of %s", frames, image->get_animation_frame_count(), image->name.c_str());
+  }
+
+  const uint16_t *EHMTX_FrameCache::frame(uint8_t icon, int frame)
+  {
+    int8_t slot = this->slot_of(icon);
+    if ((slot >= 0) && (frame < this->frames_[slot]))
+    {
+      this->hits++;
+      return this->data_ + slot * SLOT_SIZE + frame * this->pixels_[slot];
+    }
+    this->misses++;
+    return nullptr;
+  }
+
+  // the icon shown by a queue slot or MAXICONS
+  uint8_t EHMTX::queue_icon(uint8_t slot)
+  {
+    EHMTX_queue *screen = this->queue[slot];
+    if (screen->shows_icon())
+    {
+      return screen->icon;
+    }
+    return MAXICONS;
+  }
+
+  // called from update(), keeps the current icon and loads the one of the next screen
+  void EHMTX::prefetch_frames()
+  {
+    uint8_t current = (this->screen_pointer < MAXQUEUE) ? this->queue_icon(this->screen_pointer) : MAXICONS;
+
+    // same choice as find_oldest_queue_element() without the diag record, screens it passes over aren't loaded
+    uint8_t next = MAXICONS;
+    time_t last_time = this->uptime();
+    for (uint8_t i = 0; i < MAXQUEUE; i++)
+    {
+      if ((i != this->screen_pointer) && (this->queue[i]->endtime > 0) && (this->queue[i]->last_time < last_time) &&
+          this->queue[i]->showable())
+      {
+        next = this->queue_icon(i);
+        last_time = this->queue[i]->last_time;
+      }
+    }
+
+    int8_t keep = this->frame_cache.slot_of(current);
+    if ((current != MAXICONS) && (keep < 0))
+    {
+      keep = (this->frame_cache.slot_of(next) == 0) ? 1 : 0;
+      this->frame_cache.fill(keep, current, this->icons[current]);
+    }
+    if ((next != MAXICONS) && (this->frame_cache.slot_of(next) < 0))
+    {
+      this->frame_cache.fill((keep == 0) ? 1 : 0, next, this->icons[next]);
+    }
+  }
+#endif
+}
@@ -0,0 +1,251 @@
+#include "esphome.h"
+
+namespace esphome
+{
+  void EHMTX_Graph::clear()
+  {
+    this->first_ = 0;
+    this->count_ = 0;
+    this->min_ = 0;
+    this->max_ = 0;
+  }
+
+  // the columns right of the icon, the oldest samples are dropped when it shrinks
+  void EHMTX_Graph::set_width(uint8_t width)
+  {
+    width = std::min<uint8_t>(width, MATRIX_WIDTH);
+    if (width == this->width_)
+    {
+      return;
+    }
+    while (this->count_ > width)
+    {
+      this->drop();
+    }
+    this->width_ = width;
+    if (this->count_ > 0)
+    {
+      this->scale();
+    }
+  }
+
+  void EHMTX_Graph::set_line(bool line)
+  {
+    if (line == this->line_)
+    {
+      return;
+    }
+    this->line_ = line;
+    if (this->count_ > 0)
+    {
+      this->scale();
+    }
+  }
+
+  // 0 is the top and 7 the bottom row, a flat graph stays in the middle
+  uint8_t EHMTX_Graph::row(float value)
+  {
+    if (!(this->max_ > this->min_))
+    {
+      return 4;
+    }
+    return 7 - (uint8_t)lroundf((value - this->min_) * 7 / (this->max_ - this->min_));
+  }
+
+  // a bar down to the bottom row, a line goes up or down to the row next to the one of the previous sample
+  uint8_t EHMTX_Graph::column(uint8_t i)
+  {
+    uint8_t y = this->row(this->samples_[(this->first_ + i) % MATRIX_WIDTH]);
+    if (!this->line_)
+    {
+      return 0xFF << y;
+    }
+    uint8_t from = y;
+    uint8_t to = y;
+    if (i > 0)
+    {
+      uint8_t previous = this->row(this->samples_[(this->first_ + i - 1) % MATRIX_WIDTH]);
+      if (previous < y)
+      {
+        from = previous + 1;
+      }
+      else if (previous > y)
+      {
+        to = previous - 1;
+      }
+    }
+    return (0xFF << from) & (0xFF >> (7 - to));
+  }
+
+  // the range changed, all columns are computed again
+  void EHMTX_Graph::scale()
+  {
+    this->min_ = this->max_ = this->samples_[this->first_];
+    for (uint8_t i = 1; i < this->count_; i++)
+    {
+      float value = this->samples_[(this->first_ + i) % MATRIX_WIDTH];
+      this->min_ = std::min(this->min_, value);
+      this->max_ = std::max(this->max_, value);
+    }
+    for (uint8_t i = 0; i < this->count_; i++)
+    {
+      this->columns_[(this->first_ + i) % MATRIX_WIDTH] = this->column(i);
+    }
+    this->rescales++;
+  }
+
+  // the line of the new first sample doesn't connect to the dropped one
+  void EHMTX_Graph::drop()
+  {
+    this->first_ = (this->first_ + 1) % MATRIX_WIDTH;
+    this->count_--;
+    if (this->line_ && (this->count_ > 0))
+    {
+      this->columns_[this->first_] = this->column(0);
+    }
+  }
+
+  // sensors publish NaN while they have no value, those samples are skipped
+  void EHMTX_Graph::append(float value)
+  {
+    if (std::isnan(value))
+    {
+      return;
+    }
+    bool rescale = (this->count_ == 0) || (value < this->min_) || (value > this->max_);
+    if (this->count_ == this->width_)
+    {
+      float dropped = this->samples_[this->first_];
+      this->drop();
+      rescale = rescale || (dropped <= this->min_) || (dropped >= this->max_);
+    }
+    uint8_t i = (this->first_ + this->count_) % MATRIX_WIDTH;
+    this->samples_[i] = value;
+    this->count_++;
+    this->updated = millis();
+    if (rescale)
+    {
+      this->scale();
+    }
+    else
+    {
+      this->columns_[i] = this->column(this->count_ - 1);
+    }
+  }
+
+  // right aligned, the columns left of left are not drawn
+  void EHMTX_Graph::draw(display::DisplayBuffer *display, int left, Color color)
+  {
+    int x = MATRIX_WIDTH - this->count_;
+    for (uint8_t i = 0; i < this->count_; i++, x++)
+    {
+      if (x < left)
+      {
+        continue;
+      }
+      uint8_t column = this->columns_[(this->first_ + i) % MATRIX_WIDTH];
+      for (uint8_t y = 0; column != 0; y++, column >>= 1)
+      {
+        if (column & 1)
+        {
+          display->draw_pixel_at(x, y, color);
+        }
+      }
+    }
+  }
+
+  // the graph of name, a new name takes a free graph or the one fed least recently
+  uint8_t EHMTX::find_graph(const std::string &name)
+  {
+    uint8_t reuse = 0;
+    for (uint8_t i = 0; i < GRAPHS; i++)
+    {
+      if (this->graphs[i].name == name)
+      {
+        return i;
+      }
+      if (!this->graphs[reuse].name.empty() &&
+          (this->graphs[i].name.empty() || ((int32_t)(this->graphs[i].updated - this->graphs[reuse].updated) < 0)))
+      {
+        reuse = i;
+      }
+    }
+    EHMTX_Graph &graph = this->graphs[reuse];
+    if (!graph.name.empty())
+    {
+      ESP_LOGW(TAG, "graph %s dropped for %s", graph.name.c_str(), name.c_str());
+    }
+    graph.clear();
+    graph.name = name;
+    graph.updated = millis();
+    return reuse;
+  }
+
+  EHMTX_queue *EHMTX::find_graph_screen(const std::string &name)
+  {
+    time_t ts = this->uptime();
+    for (uint8_t i = 0; i < MAXQUEUE; i++)
+    {
+      if ((this->queue[i]->mode == MODE_GRAPH) && (this->queue[i]->endtime >= ts) && (this->queue[i]->icon_name == name))
+      {
+        return this->queue[i];
+      }
+    }
+    return nullptr;
+  }
+
+  // one screen per name, calling this again sets its lifetime, screen time, style and color, the samples stay
+  void EHMTX::graph_screen(std::string name, int lifetime, int screen_time, bool line, int r, int g, int b)
+  {
+    if (this->post(&EHMTX::graph_screen, std::move(name), lifetime, screen_time, line, r, g, b))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "graph_screen");
+    timer.trace(name, lifetime, screen_time, line, r, g, b);
+    EHMTX_queue *screen = this->find_graph_screen(name);
+    if (screen != nullptr)
+    {
+      this->diag(DIAG_SLOT_BY_ICON, screen->slot, screen->mode);
+      this->queue_updates++;
+      screen->added_time = millis();
+      screen->waiting = true;
+      screen->restored = false;
+    }
+    else
+    {
+      screen = this->find_free_queue_element();
+    }
+
+    screen->endtime = this->uptime() + lifetime * 60;
+    screen->text_color = Color(r, g, b);
+    screen->icon_name = std::move(name);
+    screen->mode = MODE_GRAPH;
+    screen->prepare(screen_time);
+    this->graphs[screen->graph].set_line(line);
+    screen->diag(DIAG_SCREEN_ADDED);
+  }
+
+  // a few bytes per sample instead of a bitmap, without a screen for name one is added with the defaults
+  void EHMTX::graph_append(std::string name, float value)
+  {
+    if (this->post(&EHMTX::graph_append, std::move(name), value))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "graph_append");
+    timer.trace(name, value);
+    EHMTX_queue *screen = this->find_graph_screen(name);
+    if (screen == nullptr)
+    {
+      this->graph_screen(name);
+      screen = this->find_graph_screen(name);
+    }
+    if (screen->graph_samples() == nullptr)
+    {
+      // more names than GRAPHS, another one took the graph of this screen
+      screen->prepare(screen->screen_time_);
+    }
+    this->graphs[screen->graph].append(value);
+  }
+}
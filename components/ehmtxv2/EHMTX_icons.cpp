@@ -3,35 +3,71 @@
 namespace esphome
 {
 
-  EHMTX_Icon::EHMTX_Icon(const uint8_t *data_start, int width, int height, uint32_t animation_frame_count, esphome::image::ImageType type, std::string icon_name, bool revers, uint16_t frame_duration)
+  EHMTX_Icon::EHMTX_Icon(const uint8_t *data_start, int width, int height, uint32_t animation_frame_count, esphome::image::ImageType type, std::string icon_name, bool revers, uint16_t frame_duration, const uint16_t *frame_durations)
       : Animation(data_start, width, height, animation_frame_count, type)
   {
     this->name = icon_name;
-    this->reverse = revers;
-    this->frame_duration = frame_duration;
-    this->counting_up = true;
+    this->reverse = revers && (animation_frame_count > 2);
+    this->frame_duration = std::max<uint16_t>(frame_duration, 1);
+    this->frame_durations_ = frame_durations;
+
+    this->cycle_time_ = 0;
+    for (uint32_t i = 0; i < animation_frame_count; i++)
+    {
+      this->cycle_time_ += this->get_frame_duration(i);
+    }
+    if (this->reverse)
+    {
+      for (uint32_t i = 1; i < animation_frame_count - 1; i++)
+      {
+        this->cycle_time_ += this->get_frame_duration(i);
+      }
+    }
+  }
+
+  uint16_t EHMTX_Icon::get_frame_duration(int frame)
+  {
+    if (this->frame_durations_ == nullptr)
+    {
+      return this->frame_duration;
+    }
+    return std::max<uint16_t>(progmem_read_uint16(this->frame_durations_ + frame), 1);
   }
 
-  void EHMTX_Icon::next_frame()
+  // the frame shown elapsed ms after the start, with pingpong 0..n-1 and back to 1
+  int EHMTX_Icon::frame_at(uint32_t elapsed)
   {
-    if (this->get_animation_frame_count() > 1)
+    const int frames = this->get_animation_frame_count();
+    if (frames < 2)
+    {
+      return 0;
+    }
+    elapsed %= this->cycle_time_;
+
+    if (this->frame_durations_ == nullptr)
     {
-      if (this->counting_up)
+      int step = elapsed / this->frame_duration;
+      return (step < frames) ? step : 2 * (frames - 1) - step;
+    }
+
+    for (int i = 0; i < frames; i++)
+    {
+      uint16_t duration = this->get_frame_duration(i);
+      if (elapsed < duration)
       {
-        if (this->reverse && (this->get_current_frame() == this->get_animation_frame_count() - 2))
-        {
-          this->counting_up = false;
-        }
-        Animation::next_frame();
+        return i;
       }
-      else
+      elapsed -= duration;
+    }
+    for (int i = frames - 2; i > 0; i--)
+    {
+      uint16_t duration = this->get_frame_duration(i);
+      if (elapsed < duration)
       {
-        if (this->get_current_frame() == 1) // this->get_animation_frame_count())
-        {
-          this->counting_up = true;
-        }
-        Animation::prev_frame();
+        return i;
       }
+      elapsed -= duration;
     }
+    return 0;
   }
 }
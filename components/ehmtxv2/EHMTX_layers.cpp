@@ -0,0 +1,193 @@
+#include "esphome.h"
+
+namespace esphome
+{
+#define MODE_BIT(mode) (1 << (mode))
+
+  struct EHMTX_LayerRule
+  {
+    uint16_t hidden_modes; // MODE_BIT of the screens the layer is not drawn on
+    int8_t hidden_by;      // layer that hides this one while it is active, -1 for none
+  };
+
+  // indexed by layer_id, a new overlay needs a row here and a case in render_layer()
+  static const EHMTX_LayerRule LAYER_RULES[LAYER_COUNT] = {
+      {MODE_BIT(MODE_FULL_SCREEN) | MODE_BIT(MODE_BITMAP_SCREEN), -1}, // LAYER_GAUGE
+#ifdef EHMTXv2_ALWAYS_SHOW_RLINDICATORS
+      {0, -1}, // LAYER_RINDICATOR
+      {0, -1}, // LAYER_LINDICATOR
+#else
+      {MODE_BIT(MODE_CLOCK) | MODE_BIT(MODE_DATE) | MODE_BIT(MODE_FULL_SCREEN) | MODE_BIT(MODE_BITMAP_SCREEN), -1},
+      {MODE_BIT(MODE_CLOCK) | MODE_BIT(MODE_DATE) | MODE_BIT(MODE_FULL_SCREEN) | MODE_BIT(MODE_BITMAP_SCREEN) |
+           MODE_BIT(MODE_ICON_SCREEN) | MODE_BIT(MODE_RAINBOW_ICON),
+       LAYER_GAUGE},
+#endif
+      {0, -1}, // LAYER_ALARM
+  };
+
+  void EHMTX_Layer::clear()
+  {
+    this->pixels.clear();
+    this->active = false;
+  }
+
+  void EHMTX_Layer::pixel(int x, int y, Color color)
+  {
+    this->pixels.push_back({(uint8_t)x, (uint8_t)y, color});
+    this->active = true;
+  }
+
+  // same pixels as DisplayBuffer::line()
+  void EHMTX_Layer::line(int x1, int y1, int x2, int y2, Color color)
+  {
+    const int dx = abs(x2 - x1), sx = x1 < x2 ? 1 : -1;
+    const int dy = -abs(y2 - y1), sy = y1 < y2 ? 1 : -1;
+    int err = dx + dy;
+    while (true)
+    {
+      this->pixel(x1, y1, color);
+      if ((x1 == x2) && (y1 == y2))
+      {
+        break;
+      }
+      int e2 = 2 * err;
+      if (e2 >= dy)
+      {
+        err += dy;
+        x1 += sx;
+      }
+      if (e2 <= dx)
+      {
+        err += dx;
+        y1 += sy;
+      }
+    }
+  }
+
+  void EHMTX_Layer::draw(display::DisplayBuffer *display)
+  {
+    for (const EHMTX_LayerPixel &p : this->pixels)
+    {
+      display->draw_pixel_at(p.x, p.y, p.color);
+    }
+  }
+
+  void EHMTX::layer_changed(uint8_t layer)
+  {
+    this->layers[layer].dirty = true;
+  }
+
+  bool EHMTX::layer_visible(uint8_t layer, uint8_t mode)
+  {
+    const EHMTX_LayerRule &rule = LAYER_RULES[layer];
+    if (rule.hidden_modes & MODE_BIT(mode))
+    {
+      return false;
+    }
+    return (rule.hidden_by < 0) || !this->layers[rule.hidden_by].active;
+  }
+
+  // called by draw() after the screen, the display is cleared before each frame
+  void EHMTX::draw_layers(uint8_t mode)
+  {
+    for (uint8_t i = 0; i < LAYER_COUNT; i++)
+    {
+      if (this->layers[i].dirty)
+      {
+        this->render_layer(i);
+      }
+    }
+    for (uint8_t i = 0; i < LAYER_COUNT; i++)
+    {
+      if (this->layers[i].active && this->layer_visible(i, mode))
+      {
+        this->layers[i].draw(this->target);
+      }
+    }
+  }
+
+  void EHMTX::render_layer(uint8_t layer)
+  {
+    EHMTX_Layer *l = &this->layers[layer];
+    l->clear();
+    switch (layer)
+    {
+    case LAYER_GAUGE:
+      this->render_gauge(l);
+      break;
+    case LAYER_RINDICATOR:
+      this->render_rindicator(l);
+      break;
+    case LAYER_LINDICATOR:
+      this->render_lindicator(l);
+      break;
+    case LAYER_ALARM:
+      this->render_alarm(l);
+      break;
+    }
+    l->dirty = false;
+  }
+
+  void EHMTX::render_gauge(EHMTX_Layer *layer)
+  {
+    if (this->display_gauge)
+    {
+      for (uint8_t y = 0; y < 8; y++)
+      {
+        layer->pixel(0, y, this->cgauge[y]);
+      }
+      layer->line(1, 7, 1, 0, esphome::display::COLOR_OFF);
+    }
+  }
+
+  void EHMTX::render_alarm(EHMTX_Layer *layer)
+  {
+    if (this->display_alarm > 2)
+    {
+      layer->line(MATRIX_WIDTH - 1, 2, MATRIX_WIDTH - 3, 0, this->alarm_color);
+    }
+    if (this->display_alarm > 1)
+    {
+      layer->pixel(MATRIX_WIDTH - 2, 0, this->alarm_color);
+      layer->pixel(MATRIX_WIDTH - 1, 1, this->alarm_color);
+    }
+    if (this->display_alarm > 0)
+    {
+      layer->pixel(MATRIX_WIDTH - 1, 0, this->alarm_color);
+    }
+  }
+
+  void EHMTX::render_rindicator(EHMTX_Layer *layer)
+  {
+    if (this->display_rindicator > 2)
+    {
+      layer->line(MATRIX_WIDTH - 1, MATRIX_HEIGHT - 3, MATRIX_WIDTH - 3, MATRIX_HEIGHT - 1, this->rindicator_color);
+    }
+    if (this->display_rindicator > 1)
+    {
+      layer->pixel(MATRIX_WIDTH - 2, MATRIX_HEIGHT - 1, this->rindicator_color);
+      layer->pixel(MATRIX_WIDTH - 1, MATRIX_HEIGHT - 2, this->rindicator_color);
+    }
+    if (this->display_rindicator > 0)
+    {
+      layer->pixel(MATRIX_WIDTH - 1, MATRIX_HEIGHT - 1, this->rindicator_color);
+    }
+  }
+
+  void EHMTX::render_lindicator(EHMTX_Layer *layer)
+  {
+    if (this->display_lindicator > 2)
+    {
+      layer->line(0, MATRIX_HEIGHT - 3, 2, MATRIX_HEIGHT - 1, this->lindicator_color);
+    }
+    if (this->display_lindicator > 1)
+    {
+      layer->pixel(1, MATRIX_HEIGHT - 1, this->lindicator_color);
+      layer->pixel(0, MATRIX_HEIGHT - 2, this->lindicator_color);
+    }
+    if (this->display_lindicator > 0)
+    {
+      layer->pixel(0, MATRIX_HEIGHT - 1, this->lindicator_color);
+    }
+  }
+}
@@ -0,0 +1,463 @@
+#include "esphome.h"
+
+#ifdef EHMTXv2_PERSIST_SIZE
+namespace esphome
+{
+  // snapshot layout, little endian:
+  //   header:  version, screens, length (2), checksum (2), matrix width, matrix height, flags, 0,
+  //            time of the snapshot (4, 0 without a valid clock)
+  //   bitmaps: the 565 pixels of bitmap with PERSIST_BITMAP in flags, then those of sbitmap with PERSIST_SMALL_BITMAP
+  //   screens: mode, default font, screen time (2), remaining lifetime in s (4), r, g, b,
+  //            icon name length, icon name, text length (2), text
+  // icons are stored by name, their index changes when the icon list of the firmware changes
+  static const uint8_t PERSIST_VERSION = 2;
+  static const uint8_t PERSIST_HEADER = 14;
+  static const uint8_t PERSIST_BITMAP = 1;
+  static const uint8_t PERSIST_SMALL_BITMAP = 2;
+  static const uint32_t PERSIST_DEBOUNCE = 2000; // ms without service calls before the queue is serialized
+
+  // bounds checked, ok turns false when something did not fit
+  struct EHMTX_SnapshotWriter
+  {
+    uint8_t *data;
+    uint16_t pos;
+    bool ok;
+
+    void u8(uint8_t v)
+    {
+      if (this->pos >= EHMTXv2_PERSIST_SIZE)
+      {
+        this->ok = false;
+        return;
+      }
+      this->data[this->pos++] = v;
+    }
+    void u16(uint16_t v)
+    {
+      this->u8(v & 255);
+      this->u8(v >> 8);
+    }
+    void u32(uint32_t v)
+    {
+      this->u16(v & 0xFFFF);
+      this->u16(v >> 16);
+    }
+    void bytes(const std::string &s)
+    {
+      for (char c : s)
+      {
+        this->u8(c);
+      }
+    }
+  };
+
+  struct EHMTX_SnapshotReader
+  {
+    const uint8_t *data;
+    uint16_t pos;
+    uint16_t length;
+    bool ok;
+
+    uint8_t u8()
+    {
+      if (this->pos >= this->length)
+      {
+        this->ok = false;
+        return 0;
+      }
+      return this->data[this->pos++];
+    }
+    uint16_t u16()
+    {
+      uint16_t v = this->u8();
+      return v | (this->u8() << 8);
+    }
+    uint32_t u32()
+    {
+      uint32_t v = this->u16();
+      return v | ((uint32_t)this->u16() << 16);
+    }
+    std::string bytes(uint16_t count)
+    {
+      if (this->pos + count > this->length)
+      {
+        this->ok = false;
+        return "";
+      }
+      std::string s((const char *)this->data + this->pos, count);
+      this->pos += count;
+      return s;
+    }
+  };
+
+  // Fletcher-16 over everything behind the checksum
+  static uint16_t snapshot_checksum(const uint8_t *data, uint16_t length)
+  {
+    uint16_t sum1 = 0;
+    uint16_t sum2 = 0;
+    for (uint16_t i = 6; i < length; i++)
+    {
+      sum1 = (sum1 + data[i]) % 255;
+      sum2 = (sum2 + sum1) % 255;
+    }
+    return (sum2 << 8) | sum1;
+  }
+
+  static uint16_t snapshot_length(const uint8_t *data)
+  {
+    return data[2] | (data[3] << 8);
+  }
+
+  // the same screens, only the checksum and the time of the snapshot may differ
+  static bool snapshot_equal(const uint8_t *a, const uint8_t *b)
+  {
+    uint16_t length = snapshot_length(a);
+    return (length == snapshot_length(b)) && (length >= PERSIST_HEADER) && (length <= EHMTXv2_PERSIST_SIZE) && (memcmp(a, b, 4) == 0) && (memcmp(a + 6, b + 6, 4) == 0) &&
+           (memcmp(a + PERSIST_HEADER, b + PERSIST_HEADER, length - PERSIST_HEADER) == 0);
+  }
+
+  void EHMTX::set_persist_interval(uint32_t ms)
+  {
+    this->persist_interval_ = ms;
+  }
+
+  // end of every service call, the snapshot follows once the calls pause
+  void EHMTX::persist_changed()
+  {
+    this->persist_dirty_ = true;
+    this->persist_changed_ = millis();
+  }
+
+#ifdef EHMTXv2_RENDER_TASK
+  EHMTX_Snapshot *EHMTX::snapshot_back()
+  {
+    return this->snapshots_.back();
+  }
+
+  void EHMTX::publish_snapshot()
+  {
+    this->snapshots_.publish();
+  }
+
+  EHMTX_Snapshot *EHMTX::fresh_snapshot()
+  {
+    return this->snapshots_.fresh();
+  }
+#else
+  EHMTX_Snapshot *EHMTX::snapshot_back()
+  {
+    return &this->snapshots_[0];
+  }
+
+  void EHMTX::publish_snapshot()
+  {
+    this->snapshot_fresh_ = true;
+  }
+
+  EHMTX_Snapshot *EHMTX::fresh_snapshot()
+  {
+    if (!this->snapshot_fresh_)
+    {
+      return nullptr;
+    }
+    this->snapshot_fresh_ = false;
+    return &this->snapshots_[0];
+  }
+#endif
+
+  static uint8_t bitmap_flag(uint8_t mode)
+  {
+    return (mode == MODE_BITMAP_SCREEN) ? PERSIST_BITMAP : (mode == MODE_BITMAP_SMALL) ? PERSIST_SMALL_BITMAP : 0;
+  }
+
+  // the bitmaps and then the screens that fit in slot order, returns the length
+  uint16_t EHMTX::write_snapshot(uint8_t *data)
+  {
+    EHMTX_SnapshotWriter w = {data, PERSIST_HEADER, true};
+    time_t ts = this->uptime();
+    uint8_t flags = 0;
+    uint8_t count = 0;
+    uint8_t skipped = 0;
+
+    for (uint8_t i = 0; i < MAXQUEUE; i++)
+    {
+      if ((this->queue[i]->mode != MODE_EMPTY) && (this->queue[i]->endtime >= ts))
+      {
+        flags |= bitmap_flag(this->queue[i]->mode);
+      }
+    }
+    for (uint8_t flag = PERSIST_BITMAP; flag <= PERSIST_SMALL_BITMAP; flag <<= 1)
+    {
+      const uint16_t *pixels = (flag == PERSIST_BITMAP) ? this->bitmap : this->sbitmap;
+      uint16_t size = (flag == PERSIST_BITMAP) ? MATRIX_PIXELS : 64;
+      if (!(flags & flag))
+      {
+        continue;
+      }
+      if (w.pos + 2 * size > EHMTXv2_PERSIST_SIZE)
+      {
+        flags &= ~flag;
+        continue;
+      }
+      for (uint16_t p = 0; p < size; p++)
+      {
+        w.u16(pixels[p]);
+      }
+    }
+
+    for (uint8_t i = 0; i < MAXQUEUE; i++)
+    {
+      EHMTX_queue *screen = this->queue[i];
+      // a timer runs on millis(), it can't go on after a reboot
+      if ((screen->mode == MODE_EMPTY) || (screen->mode == MODE_TIMER) || (screen->endtime < ts))
+      {
+        continue;
+      }
+      uint8_t bitmap = bitmap_flag(screen->mode);
+      uint16_t start = w.pos;
+      if (bitmap == 0 || (flags & bitmap))
+      {
+        uint8_t type = EHMTX_queue::mode_flags(screen->mode);
+        uint8_t name_length = (type & SCREEN_ICON) ? std::min<size_t>(screen->icon_name.size(), 255) : 0;
+        uint16_t text_length = (type & SCREEN_TEXT) ? std::min<size_t>(screen->text.size(), EHMTXv2_PERSIST_SIZE) : 0;
+        w.u8(screen->mode);
+        w.u8(screen->default_font);
+        w.u16(screen->screen_time_);
+        w.u32(screen->endtime - ts);
+        w.u8(screen->text_color.r);
+        w.u8(screen->text_color.g);
+        w.u8(screen->text_color.b);
+        w.u8(name_length);
+        w.bytes(screen->icon_name.substr(0, name_length));
+        w.u16(text_length);
+        w.bytes(screen->text.substr(0, text_length));
+      }
+      if ((bitmap != 0 && !(flags & bitmap)) || !w.ok)
+      {
+        w.pos = start;
+        w.ok = true;
+        skipped++;
+        continue;
+      }
+      count++;
+    }
+    if (skipped > 0)
+    {
+      ESP_LOGW(TAG, "persist: %d screens don't fit in persist_size", skipped);
+    }
+
+    data[0] = PERSIST_VERSION;
+    data[1] = count;
+    data[2] = w.pos & 255;
+    data[3] = w.pos >> 8;
+    data[6] = MATRIX_WIDTH;
+    data[7] = MATRIX_HEIGHT;
+    data[8] = flags;
+    data[9] = 0;
+    uint32_t now = this->clock->now().is_valid() ? this->clock->now().timestamp : 0;
+    for (uint8_t i = 0; i < 4; i++)
+    {
+      data[10 + i] = (now >> (8 * i)) & 255;
+    }
+    uint16_t checksum = snapshot_checksum(data, w.pos);
+    data[4] = checksum & 255;
+    data[5] = checksum >> 8;
+    return w.pos;
+  }
+
+  // fills the queue from slot 0, returns the number of screens
+  uint8_t EHMTX::read_snapshot(const uint8_t *data)
+  {
+    uint16_t length = snapshot_length(data);
+    if ((data[0] != PERSIST_VERSION) || (length < PERSIST_HEADER) || (length > EHMTXv2_PERSIST_SIZE) ||
+        ((data[4] | (data[5] << 8)) != snapshot_checksum(data, length)))
+    {
+      ESP_LOGW(TAG, "persist: no valid snapshot");
+      return 0;
+    }
+    if ((data[6] != MATRIX_WIDTH) || (data[7] != MATRIX_HEIGHT))
+    {
+      ESP_LOGW(TAG, "persist: snapshot of a %dx%d matrix ignored", data[6], data[7]);
+      return 0;
+    }
+    EHMTX_SnapshotReader r = {data, 10, length, true};
+    uint32_t saved = r.u32();
+    uint8_t flags = data[8];
+
+    for (uint8_t flag = PERSIST_BITMAP; flag <= PERSIST_SMALL_BITMAP; flag <<= 1)
+    {
+      if (!(flags & flag))
+      {
+        continue;
+      }
+      uint16_t size = (flag == PERSIST_BITMAP) ? MATRIX_PIXELS : 64;
+      for (uint16_t p = 0; p < size; p++)
+      {
+        ((flag == PERSIST_BITMAP) ? this->bitmap : this->sbitmap)[p] = r.u16();
+      }
+    }
+
+    // the time the device was off is known once the clock is valid, until then the screens count from now
+    time_t ts = this->uptime();
+    time_t off = 0;
+    if ((saved != 0) && this->clock->now().is_valid())
+    {
+      off = std::max<time_t>(this->clock->now().timestamp - (time_t)saved, 0);
+    }
+    else
+    {
+      this->persist_time_ = saved;
+    }
+    this->persist_restored_ = ts;
+    uint8_t restored = 0;
+    for (uint8_t i = 0; (i < data[1]) && (restored < MAXQUEUE); i++)
+    {
+      uint8_t mode = r.u8();
+      bool default_font = r.u8();
+      uint16_t screen_time = r.u16();
+      time_t endtime = ts + (time_t)r.u32() - off;
+      uint8_t red = r.u8();
+      uint8_t green = r.u8();
+      uint8_t blue = r.u8();
+      std::string icon_name = r.bytes(r.u8());
+      std::string text = r.bytes(r.u16());
+      if (!r.ok || (mode == MODE_EMPTY) || (mode >= MODE_COUNT))
+      {
+        break;
+      }
+      if (endtime < ts)
+      {
+        continue;
+      }
+      uint8_t icon = MAXICONS;
+      uint8_t flags = EHMTX_queue::mode_flags(mode);
+      if (flags & SCREEN_ICON)
+      {
+        icon = this->find_icon(icon_name, !(flags & SCREEN_NAMED));
+        if ((icon >= this->icon_count) && !(flags & SCREEN_NAMED))
+        {
+          ESP_LOGW(TAG, "persist: icon %s is gone, screen dropped", icon_name.c_str());
+          continue;
+        }
+      }
+      EHMTX_queue *screen = this->queue[restored++];
+      screen->mode = (show_mode)mode;
+      screen->default_font = default_font;
+      screen->endtime = endtime;
+      screen->last_time = 0;
+      screen->text_color = Color(red, green, blue);
+      screen->icon_name = std::move(icon_name);
+      screen->icon = icon;
+      screen->text = std::move(text);
+      screen->added_time = millis();
+      screen->waiting = true;
+      screen->restored = true;
+      screen->prepare(screen_time);
+      screen->diag(DIAG_SCREEN_ADDED);
+    }
+    return restored;
+  }
+
+  // called by setup() after the fonts are baked
+  void EHMTX::restore_queue()
+  {
+    this->persist_pref_ = global_preferences->make_preference<EHMTX_Snapshot>(fnv1_hash("ehmtxv2_queue"), true);
+    EHMTX_Snapshot *snapshot = this->snapshot_back();
+    if (!this->persist_pref_.load(snapshot))
+    {
+      ESP_LOGD(TAG, "persist: nothing stored");
+      return;
+    }
+    this->restored_screens = this->read_snapshot(snapshot->data);
+    this->persist_stored_ = *snapshot;
+    this->persist_has_stored_ = true;
+    ESP_LOGI(TAG, "persist: %d screens restored", this->restored_screens);
+  }
+
+  // called at the first valid time, the restored screens lose the time the device was off
+  void EHMTX::rebase_restored()
+  {
+    if (this->persist_time_ == 0)
+    {
+      return;
+    }
+    time_t booted = this->clock->now().timestamp - (this->uptime() - this->persist_restored_);
+    time_t off = std::max<time_t>(booted - (time_t)this->persist_time_, 0);
+    for (uint8_t i = 0; i < MAXQUEUE; i++)
+    {
+      EHMTX_queue *screen = this->queue[i];
+      if (screen->restored && (screen->mode != MODE_EMPTY))
+      {
+        screen->endtime = std::max<time_t>(screen->endtime - off, 1);
+      }
+    }
+    ESP_LOGI(TAG, "persist: restored screens rebased by %d s", (int)off);
+    this->persist_time_ = 0;
+  }
+
+  // where the queue is changed, in the render task if there is one
+  void EHMTX::take_snapshot(bool force)
+  {
+    if (!this->persist_dirty_ || (!force && (millis() - this->persist_changed_ < PERSIST_DEBOUNCE)))
+    {
+      return;
+    }
+    this->write_snapshot(this->snapshot_back()->data);
+    this->publish_snapshot();
+    this->persist_dirty_ = false;
+  }
+
+  // main loop, unchanged snapshots are not written and the others at most every persist_interval,
+  // the preferences reach the flash with their own flash_write_interval and before a reboot
+  void EHMTX::save_snapshot(bool force)
+  {
+#ifdef EHMTXv2_RENDER_TASK
+    if (this->in_render_task())
+    {
+      return;
+    }
+#endif
+    EHMTX_Snapshot *fresh = this->fresh_snapshot();
+    if (fresh != nullptr)
+    {
+      this->persist_unsaved_ = fresh;
+    }
+    if ((this->persist_unsaved_ == nullptr) || (!force && (millis() - this->persist_saved_ < this->persist_interval_)))
+    {
+      return;
+    }
+    EHMTX_Snapshot *snapshot = this->persist_unsaved_;
+    this->persist_unsaved_ = nullptr;
+    if (this->persist_has_stored_ && snapshot_equal(snapshot->data, this->persist_stored_.data))
+    {
+      return;
+    }
+    if (this->persist_pref_.save(snapshot))
+    {
+      this->persist_stored_ = *snapshot;
+      this->persist_has_stored_ = true;
+      this->persist_saved_ = millis();
+      this->persist_writes++;
+      ESP_LOGD(TAG, "persist: %d screens, %d bytes saved", snapshot->data[1], snapshot_length(snapshot->data));
+    }
+    else
+    {
+      ESP_LOGW(TAG, "persist: snapshot not saved");
+    }
+  }
+
+  // reboot or OTA, the render task keeps the queue, its last snapshot is at most PERSIST_DEBOUNCE old
+  void EHMTX::on_safe_shutdown()
+  {
+#ifdef EHMTXv2_RENDER_TASK
+    if (this->render_task_ == nullptr)
+    {
+      this->take_snapshot(true);
+    }
+#else
+    this->take_snapshot(true);
+#endif
+    this->save_snapshot(true);
+  }
+}
+#endif
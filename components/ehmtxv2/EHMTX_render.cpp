@@ -0,0 +1,164 @@
+#include "esphome.h"
+
+#ifdef EHMTXv2_RENDER_TASK
+namespace esphome
+{
+  static const uint32_t RENDER_TASK_STACK = 6144; // bytes
+  static const UBaseType_t RENDER_TASK_PRIORITY = 2;
+
+  struct EHMTX_LogLine
+  {
+    uint8_t level;
+    const char *tag;
+    char text[LOG_LINE];
+  };
+
+  // written by the render task, emptied by loop()
+  static EHMTX_Ring<EHMTX_LogLine, LOG_QUEUE> log_lines;
+  static std::atomic<uint32_t> log_dropped{0};
+  static TaskHandle_t log_task = nullptr;
+
+  bool EHMTX_defer_log(uint8_t level, const char *tag, const char *format, ...)
+  {
+    if ((log_task == nullptr) || (xTaskGetCurrentTaskHandle() != log_task))
+    {
+      return false;
+    }
+    EHMTX_LogLine line;
+    line.level = level;
+    line.tag = tag;
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line.text, sizeof(line.text), format, args);
+    va_end(args);
+    if (!log_lines.push(std::move(line)))
+    {
+      log_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    return true;
+  }
+
+  void EHMTX_flush_log()
+  {
+    EHMTX_LogLine line;
+    while (log_lines.pop(line))
+    {
+      switch (line.level)
+      {
+      case ESPHOME_LOG_LEVEL_ERROR:
+        esph_log_e(line.tag, "%s", line.text);
+        break;
+      case ESPHOME_LOG_LEVEL_WARN:
+        esph_log_w(line.tag, "%s", line.text);
+        break;
+      case ESPHOME_LOG_LEVEL_INFO:
+        esph_log_i(line.tag, "%s", line.text);
+        break;
+      case ESPHOME_LOG_LEVEL_DEBUG:
+        esph_log_d(line.tag, "%s", line.text);
+        break;
+      default:
+        esph_log_v(line.tag, "%s", line.text);
+        break;
+      }
+    }
+    uint32_t dropped = log_dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0)
+    {
+      esph_log_w(TAG, "%d log lines of the render task dropped", (int)dropped);
+    }
+  }
+
+  void EHMTX_FrameBuffer::begin_frame()
+  {
+    for (uint16_t i = 0; i < MATRIX_PIXELS; i++)
+    {
+      this->pixels_[this->back_][i] = esphome::display::COLOR_OFF;
+    }
+  }
+
+  void EHMTX_FrameBuffer::draw_absolute_pixel_internal(int x, int y, Color color)
+  {
+    if ((x >= 0) && (x < MATRIX_WIDTH) && (y >= 0) && (y < MATRIX_HEIGHT))
+    {
+      this->pixels_[this->back_][x + y * MATRIX_WIDTH] = color;
+    }
+  }
+
+  // render task, the drawn frame becomes the newest one and the previous newest one is drawn over next
+  void EHMTX_FrameBuffer::publish()
+  {
+    this->back_ = this->ready_.exchange(this->back_ | FRESH, std::memory_order_acq_rel) & ~FRESH;
+  }
+
+  // display lambda, takes the newest frame if there is one, otherwise the last one is shown again
+  void EHMTX_FrameBuffer::show(display::DisplayBuffer *display)
+  {
+    if (this->ready_.load(std::memory_order_acquire) & FRESH)
+    {
+      this->front_ = this->ready_.exchange(this->front_, std::memory_order_acq_rel) & ~FRESH;
+    }
+    const Color *pixels = this->pixels_[this->front_];
+    for (uint8_t y = 0; y < MATRIX_HEIGHT; y++)
+    {
+      for (uint8_t x = 0; x < MATRIX_WIDTH; x++)
+      {
+        // the display is cleared before the lambda
+        if (pixels[x + y * MATRIX_WIDTH].raw_32 != 0)
+        {
+          display->draw_pixel_at(x, y, pixels[x + y * MATRIX_WIDTH]);
+        }
+      }
+    }
+  }
+
+  // called at the end of setup(), from then on tick() and draw() run in the task and the services are queued
+  void EHMTX::start_render_task()
+  {
+    this->frame_buffer_ = new EHMTX_FrameBuffer();
+    this->target = this->frame_buffer_;
+    // the other core than the main loop, the handle is set before the task runs
+    BaseType_t core = (portNUM_PROCESSORS > 1) ? 1 - xPortGetCoreID() : tskNO_AFFINITY;
+    if (xTaskCreatePinnedToCore(EHMTX::render_task, "ehmtx_render", RENDER_TASK_STACK, this, RENDER_TASK_PRIORITY,
+                                &this->render_task_, core) != pdPASS)
+    {
+      ESP_LOGE(TAG, "render task not started, drawing from the main loop");
+      this->render_task_ = nullptr;
+      this->target = this->display;
+      return;
+    }
+    ESP_LOGD(TAG, "render task started on core %d", core);
+  }
+
+  void EHMTX::render_task(void *arg)
+  {
+    EHMTX *self = (EHMTX *)arg;
+    log_task = xTaskGetCurrentTaskHandle();
+    TickType_t wake = xTaskGetTickCount();
+    while (true)
+    {
+      self->render_frame();
+      uint32_t interval = self->display->get_update_interval();
+      vTaskDelayUntil(&wake, (interval > 0) ? pdMS_TO_TICKS(interval) : 1);
+    }
+  }
+
+  void EHMTX::render_frame()
+  {
+    EHMTX_Command command;
+    while (this->commands_.pop(command))
+    {
+      command();
+    }
+    this->frame_buffer_->begin_frame();
+    this->tick();
+    this->draw();
+    this->frame_buffer_->publish();
+  }
+
+  bool EHMTX::in_render_task()
+  {
+    return xTaskGetCurrentTaskHandle() == this->render_task_;
+  }
+}
+#endif
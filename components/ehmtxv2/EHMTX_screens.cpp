@@ -0,0 +1,381 @@
+#include "esphome.h"
+
+namespace esphome
+{
+  // indexed by show_mode, a new screen type needs a row here with its prepare and render functions, and the
+  // showable and status hooks when the flags do not describe it
+  const EHMTX_ScreenType EHMTX_queue::TYPES[MODE_COUNT] = {
+      {"empty slot", 0, &EHMTX_queue::prepare_static, &EHMTX_queue::render_none, nullptr, nullptr},                                  // MODE_EMPTY
+      {"blank screen", 0, &EHMTX_queue::prepare_static, &EHMTX_queue::render_none, nullptr, nullptr},                                // MODE_BLANK
+      {"clock", SCREEN_TIME, &EHMTX_queue::prepare_time, &EHMTX_queue::render_time<false, false>, nullptr, nullptr},                 // MODE_CLOCK
+      {"date", SCREEN_TIME, &EHMTX_queue::prepare_time, &EHMTX_queue::render_time<false, true>, nullptr, nullptr},                   // MODE_DATE
+      {"full screen", SCREEN_ICON, &EHMTX_queue::prepare_static, &EHMTX_queue::render_full, nullptr, nullptr},                       // MODE_FULL_SCREEN
+      {"icon screen", SCREEN_ICON | SCREEN_TEXT, &EHMTX_queue::prepare_text<8>, &EHMTX_queue::render_icon<false>, nullptr, nullptr}, // MODE_ICON_SCREEN
+      {"text", SCREEN_TEXT, &EHMTX_queue::prepare_text<0>, &EHMTX_queue::render_text<false>, nullptr, nullptr},                      // MODE_TEXT_SCREEN
+      {"rainbow icon", SCREEN_ICON | SCREEN_TEXT, &EHMTX_queue::prepare_text<8>, &EHMTX_queue::render_icon<true>, nullptr, nullptr}, // MODE_RAINBOW_ICON
+      {"rainbow text", SCREEN_TEXT, &EHMTX_queue::prepare_text<0>, &EHMTX_queue::render_text<true>, nullptr, nullptr},               // MODE_RAINBOW_TEXT
+      {"rainbow clock", SCREEN_TIME, &EHMTX_queue::prepare_time, &EHMTX_queue::render_time<true, false>, nullptr, nullptr},          // MODE_RAINBOW_CLOCK
+      {"rainbow date", SCREEN_TIME, &EHMTX_queue::prepare_time, &EHMTX_queue::render_time<true, true>, nullptr, nullptr},            // MODE_RAINBOW_DATE
+      {"bitmap", 0, &EHMTX_queue::prepare_static, &EHMTX_queue::render_bitmap, nullptr, nullptr},                                    // MODE_BITMAP_SCREEN
+      {"small bitmap", SCREEN_TEXT, &EHMTX_queue::prepare_text<8>, &EHMTX_queue::render_bitmap_small, nullptr, nullptr},             // MODE_BITMAP_SMALL
+      {"ticker", 0, &EHMTX_queue::prepare_ticker, &EHMTX_queue::render_ticker, &EHMTX_queue::showable_ticker, &EHMTX_queue::status_ticker}, // MODE_TICKER
+      {"graph", SCREEN_ICON | SCREEN_NAMED, &EHMTX_queue::prepare_graph, &EHMTX_queue::render_graph, &EHMTX_queue::showable_graph, &EHMTX_queue::status_graph}, // MODE_GRAPH
+      {"timer", SCREEN_ICON | SCREEN_NAMED, &EHMTX_queue::prepare_timer, &EHMTX_queue::render_timer, nullptr, &EHMTX_queue::status_timer}, // MODE_TIMER
+  };
+
+
+  // called once by the services after mode, text, font and icon are set
+  void EHMTX_queue::prepare(uint16_t screen_time)
+  {
+    this->font_ = this->default_font ? this->config_->default_font : this->config_->special_font;
+    this->atlas_ = this->default_font ? this->config_->default_atlas : this->config_->special_atlas;
+    this->xoffset_ = this->default_font ? EHMTXv2_DEFAULT_FONT_OFFSET_X : EHMTXv2_SPECIAL_FONT_OFFSET_X;
+    this->yoffset_ = this->default_font ? EHMTXv2_DEFAULT_FONT_OFFSET_Y : EHMTXv2_SPECIAL_FONT_OFFSET_Y;
+    (this->*TYPES[this->mode].prepare)(screen_time);
+  }
+
+  bool EHMTX_queue::shows_icon()
+  {
+    return (TYPES[this->mode].flags & SCREEN_ICON) && (this->icon < this->config_->icon_count);
+  }
+
+  bool EHMTX_queue::needs_time()
+  {
+    return TYPES[this->mode].flags & SCREEN_TIME;
+  }
+
+  // false while the screen has nothing to show, find_oldest_queue_element() passes over it then
+  bool EHMTX_queue::showable()
+  {
+    if (this->needs_time())
+    {
+      return this->config_->clock->now().is_valid();
+    }
+    const EHMTX_ScreenType &type = TYPES[this->mode];
+    return (type.showable == nullptr) || (this->*type.showable)();
+  }
+
+  // nullptr when the graph of this screen was taken by another name
+  EHMTX_Graph *EHMTX_queue::graph_samples()
+  {
+    EHMTX_Graph *graph = &this->config_->graphs[this->graph];
+    return (graph->name == this->icon_name) ? graph : nullptr;
+  }
+
+  void EHMTX_queue::prepare_static(uint16_t screen_time)
+  {
+    this->run.clear();
+    this->pixels_ = 0;
+    this->screen_time_ = screen_time;
+  }
+
+  void EHMTX_queue::prepare_time(uint16_t screen_time)
+  {
+    this->prepare_static(screen_time);
+    this->shaped_time_ = 0;
+    this->text_x_[0] = this->text_x_[1] = MATRIX_WIDTH / 2 - 1 + this->xoffset_;
+  }
+
+  // STARTX is the first column right of the icon, text_x_ and scroll_dir_ give the position for scroll_step
+  template <uint8_t STARTX>
+  void EHMTX_queue::prepare_text(uint16_t screen_time)
+  {
+    float display_duration;
+    uint8_t width = MATRIX_WIDTH - STARTX;
+    uint16_t max_steps = 0;
+
+#ifdef EHMTXv2_TEXT_MARKUP
+    this->run.shape(this->font_, this->text, this->config_);
+#else
+    this->run.shape(this->font_, this->text);
+#endif
+    this->pixels_ = this->run.width;
+
+    // texts next to an icon scroll one pixel earlier
+    bool scrolls = (STARTX == 0) ? (this->pixels_ >= width) : (this->pixels_ >= width - 1);
+#ifdef EHMTXv2_SCROLL_SMALL_TEXT
+    scrolls = scrolls || (STARTX == 0);
+#endif
+    if (scrolls)
+    {
+      max_steps = (EHMTXv2_SCROLL_COUNT + 1) * width + EHMTXv2_SCROLL_COUNT * this->pixels_;
+      display_duration = ceil((max_steps * EHMTXv2_SCROLL_INTERVALL) / 1000);
+      this->screen_time_ = (display_duration > screen_time) ? display_duration : screen_time;
+    }
+    else
+    {
+      this->screen_time_ = screen_time;
+    }
+    this->scroll_reset = width + this->pixels_;
+
+    // [0] without, [1] with the gauge in the first two columns
+    for (uint8_t gauge = 0; gauge < 2; gauge++)
+    {
+      uint8_t startx = STARTX + 2 * gauge;
+      int w = MATRIX_WIDTH - startx;
+#ifdef EHMTXv2_USE_RTL
+      if (this->pixels_ < w)
+      {
+        this->text_x_[gauge] = MATRIX_WIDTH - (w - this->pixels_) / 2 - this->pixels_;
+        this->scroll_dir_[gauge] = 0;
+      }
+      else
+      {
+        this->text_x_[gauge] = startx - this->pixels_;
+        this->scroll_dir_[gauge] = 1;
+      }
+#else
+#ifdef EHMTXv2_SCROLL_SMALL_TEXT
+      this->text_x_[gauge] = startx + w;
+      this->scroll_dir_[gauge] = -1;
+#else
+      if (this->pixels_ < w)
+      {
+        this->text_x_[gauge] = startx + (w - this->pixels_) / 2;
+        this->scroll_dir_[gauge] = 0;
+      }
+      else
+      {
+        this->text_x_[gauge] = startx + w;
+        this->scroll_dir_[gauge] = -1;
+      }
+#endif
+#endif
+      this->text_x_[gauge] += this->xoffset_;
+    }
+  }
+
+  // the texts are in config_->ticker, shaped with the font of this screen
+  void EHMTX_queue::prepare_ticker(uint16_t screen_time)
+  {
+    this->prepare_static(screen_time);
+    this->config_->ticker.set_font(this->font_, this->atlas_, this->xoffset_);
+  }
+
+  // the samples are in config_->graphs under icon_name, an icon of that name is shown left of them
+  void EHMTX_queue::prepare_graph(uint16_t screen_time)
+  {
+    this->prepare_static(screen_time);
+    this->icon = this->config_->find_icon(this->icon_name, false);
+    this->graph = this->config_->find_graph(this->icon_name);
+    this->config_->graphs[this->graph].set_width(this->shows_icon() ? MATRIX_WIDTH - 9 : MATRIX_WIDTH);
+  }
+
+  // the widest digit gives the cell of every digit, an icon named icon_name is optional
+  void EHMTX_queue::prepare_timer(uint16_t screen_time)
+  {
+    this->prepare_static(screen_time);
+    this->icon = this->config_->find_icon(this->icon_name, false);
+    this->timer_text_[0] = '\0';
+    this->digit_width_ = 0;
+    char digit[2] = {'0', '\0'};
+    for (; digit[0] <= '9'; digit[0]++)
+    {
+      int x1, y1, w, h;
+      int length;
+      int glyph = this->font_->match_next_glyph(digit, &length);
+      if (glyph >= 0)
+      {
+        this->font_->get_glyphs()[glyph].scan_area(&x1, &y1, &w, &h);
+        this->digit_width_ = std::max<int>(this->digit_width_, w + x1);
+      }
+    }
+  }
+
+  // the inline icons animate on the clock of the screen like its own icon
+  void EHMTX_queue::draw_text(Color color)
+  {
+    uint8_t gauge = this->config_->display_gauge ? 1 : 0;
+    int x = this->text_x_[gauge] + this->scroll_dir_[gauge] * this->config_->scroll_step;
+    this->atlas_->draw(this->config_->target, this->run, x, color);
+    for (auto &inline_icon : this->run.icons)
+    {
+      EHMTX_Icon *icon = this->config_->icons[inline_icon.icon];
+      int x_at = x + inline_icon.x;
+      if ((x_at < MATRIX_WIDTH) && (x_at + icon->get_width() > 0))
+      {
+        icon->set_frame(icon->frame_at(millis() - this->anim_start));
+        this->config_->draw_icon(x_at, 0, inline_icon.icon);
+      }
+    }
+  }
+
+  // shaped again only when the second changes, BASELINE_CENTER aligned like display->strftime()
+  void EHMTX_queue::draw_time(const char *format, Color color)
+  {
+    time_t now = this->config_->clock->now().timestamp;
+    if (now != this->shaped_time_)
+    {
+      char buffer[32];
+      this->run.clear();
+      if (this->config_->clock->now().strftime(buffer, sizeof(buffer), format) > 0)
+      {
+        this->run.shape(this->font_, buffer);
+      }
+      this->shaped_time_ = now;
+    }
+    this->atlas_->draw(this->config_->target, this->run, this->text_x_[0] - this->run.width / 2, color);
+  }
+
+  void EHMTX_queue::render_none()
+  {
+  }
+
+  void EHMTX_queue::render_full()
+  {
+    this->select_frame();
+    this->config_->draw_icon(0, 0, this->icon);
+  }
+
+  template <bool RAINBOW>
+  void EHMTX_queue::render_icon()
+  {
+    this->select_frame();
+    this->draw_text(RAINBOW ? this->config_->rainbow_color : this->text_color);
+    if (this->config_->display_gauge)
+    {
+      this->config_->draw_icon(2, 0, this->icon);
+      this->config_->target->line(10, 0, 10, 7, esphome::display::COLOR_OFF);
+    }
+    else
+    {
+      this->config_->target->line(8, 0, 8, 7, esphome::display::COLOR_OFF);
+      this->config_->draw_icon(0, 0, this->icon);
+    }
+  }
+
+  template <bool RAINBOW>
+  void EHMTX_queue::render_text()
+  {
+    this->draw_text(RAINBOW ? this->config_->rainbow_color : this->text_color);
+  }
+
+  template <bool RAINBOW, bool DATE>
+  void EHMTX_queue::render_time()
+  {
+    if (this->config_->clock->now().is_valid())
+    {
+      Color color = RAINBOW ? this->config_->rainbow_color : this->text_color;
+      this->draw_time(DATE ? EHMTXv2_DATE_FORMAT : EHMTXv2_TIME_FORMAT, color);
+      if ((this->config_->clock->now().second % 2 == 0) && this->config_->show_seconds)
+      {
+        this->config_->target->draw_pixel_at(0, 0, color);
+      }
+      if (!RAINBOW)
+      {
+        this->config_->draw_day_of_week();
+      }
+    }
+    else
+    {
+      this->config_->target->print(this->text_x_[0], this->yoffset_, this->font_, this->config_->alarm_color, display::TextAlign::BASELINE_CENTER, DATE ? "!d!" : "!t!");
+    }
+  }
+
+  bool EHMTX_queue::showable_ticker()
+  {
+    return !this->config_->ticker.empty();
+  }
+
+  void EHMTX_queue::status_ticker()
+  {
+    ESP_LOGD(TAG, "queue: %s: %d texts, %d dropped for: %d sec", TYPES[this->mode].name, this->config_->ticker.size(), this->config_->ticker.dropped, this->screen_time_);
+  }
+
+  // the ticker scrolls on its own offset, it goes on where it stopped when the screen is shown again
+  void EHMTX_queue::render_ticker()
+  {
+    EHMTX_Ticker &ticker = this->config_->ticker;
+    ticker.scroll(this->anim_start);
+    ticker.draw(this->config_->target);
+    if (ticker.empty())
+    {
+      // all texts scrolled out, the next screen comes without waiting for the screen time
+      this->config_->next_action_time = this->config_->uptime() - 1;
+    }
+  }
+
+  bool EHMTX_queue::showable_graph()
+  {
+    EHMTX_Graph *graph = this->graph_samples();
+    return (graph != nullptr) && !graph->empty();
+  }
+
+  void EHMTX_queue::status_graph()
+  {
+    EHMTX_Graph *graph = this->graph_samples();
+    ESP_LOGD(TAG, "queue: %s: \"%s\" %d samples from %.2f to %.2f for: %d sec", TYPES[this->mode].name, this->icon_name.c_str(),
+             graph ? graph->size() : 0, graph ? graph->min() : 0.0f, graph ? graph->max() : 0.0f, this->screen_time_);
+  }
+
+  void EHMTX_queue::render_graph()
+  {
+    uint8_t startx = this->config_->display_gauge ? 2 : 0;
+    if (this->shows_icon())
+    {
+      this->select_frame();
+      this->config_->draw_icon(startx, 0, this->icon);
+      startx += 9;
+    }
+    EHMTX_Graph *graph = this->graph_samples();
+    if (graph != nullptr)
+    {
+      graph->draw(this->config_->target, startx, this->text_color);
+    }
+  }
+
+  void EHMTX_queue::status_timer()
+  {
+    ESP_LOGD(TAG, "queue: %s: \"%s\" %s %s for: %d sec", TYPES[this->mode].name, this->icon_name.c_str(), this->timer_up ? "up" : "down",
+             this->timer_done ? "done" : this->timer_text_, this->screen_time_);
+  }
+
+  // the text is laid out again only when it changed, a finished countdown blinks
+  void EHMTX_queue::render_timer()
+  {
+    char text[sizeof(this->timer_text_)];
+    this->timer_text(text, sizeof(text));
+    if (strcmp(text, this->timer_text_) != 0)
+    {
+      this->layout_timer(text);
+    }
+    uint8_t startx = this->config_->display_gauge ? 2 : 0;
+    int left = this->shows_icon() ? startx + 9 : startx;
+    uint32_t now = millis();
+    if (this->timer_up || ((int32_t)(now - this->timer_ms) < 0) || ((now - this->timer_ms) % 1000 < 500))
+    {
+      this->atlas_->draw(this->config_->target, this->run, left + (MATRIX_WIDTH - left - this->run.width) / 2 + this->xoffset_, this->text_color);
+    }
+    if (this->shows_icon())
+    {
+      this->select_frame();
+      this->config_->target->line(startx + 8, 0, startx + 8, 7, esphome::display::COLOR_OFF);
+      this->config_->draw_icon(startx, 0, this->icon);
+    }
+  }
+
+  void EHMTX_queue::render_bitmap()
+  {
+    for (uint8_t x = 0; x < MATRIX_WIDTH; x++)
+    {
+      for (uint8_t y = 0; y < MATRIX_HEIGHT; y++)
+      {
+        this->config_->target->draw_pixel_at(x, y, rgb565_color(this->config_->bitmap[x + y * MATRIX_WIDTH]));
+      }
+    }
+  }
+
+  void EHMTX_queue::render_bitmap_small()
+  {
+    this->draw_text(this->text_color);
+    uint8_t startx = this->config_->display_gauge ? 2 : 0;
+    this->config_->target->line(startx + 8, 0, startx + 8, 7, esphome::display::COLOR_OFF);
+    for (uint8_t x = 0; x < 8; x++)
+    {
+      for (uint8_t y = 0; y < 8; y++)
+      {
+        this->config_->target->draw_pixel_at(x + startx, y, rgb565_color(this->config_->sbitmap[x + y * 8]));
+      }
+    }
+  }
+}
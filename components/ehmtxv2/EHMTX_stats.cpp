@@ -0,0 +1,359 @@
+#include "esphome.h"
+
+#ifdef EHMTXv2_COUNT_ALLOCATIONS
+#include <new>
+
+// counts every operator new of the firmware, debug builds only
+uint32_t EHMTX_allocations = 0;
+
+void *operator new(size_t size)
+{
+  EHMTX_allocations++;
+  void *p = malloc(size == 0 ? 1 : size);
+  if (p == nullptr)
+  {
+    abort();
+  }
+  return p;
+}
+void *operator new[](size_t size) { return operator new(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+  EHMTX_allocations++;
+  return malloc(size == 0 ? 1 : size);
+}
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept { return operator new(size, tag); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+#endif
+
+namespace esphome
+{
+
+  // lowest value of a bucket, buckets 0..7 hold exactly one value
+  static uint32_t bucket_start(uint8_t bucket)
+  {
+    if (bucket < 4)
+    {
+      return bucket;
+    }
+    return (uint32_t)(4 + (bucket & 3)) << ((bucket >> 2) - 1);
+  }
+
+  void EHMTX_Histogram::add(uint32_t us)
+  {
+    uint8_t bucket = us;
+    if (us >= 4)
+    {
+      uint8_t octave = 31 - __builtin_clz(us);
+      bucket = std::min<uint32_t>((octave - 1) * 4 + ((us >> (octave - 2)) & 3), STATS_BUCKETS - 1);
+    }
+    if (this->buckets_[bucket] == UINT16_MAX)
+    {
+      // keep the distribution, lose some resolution
+      for (uint8_t i = 0; i < STATS_BUCKETS; i++)
+      {
+        this->buckets_[i] >>= 1;
+      }
+    }
+    this->buckets_[bucket]++;
+    this->count++;
+    this->max = std::max(this->max, us);
+  }
+
+  uint32_t EHMTX_Histogram::percentile(uint8_t p)
+  {
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < STATS_BUCKETS; i++)
+    {
+      total += this->buckets_[i];
+    }
+    if (total == 0)
+    {
+      return 0;
+    }
+    uint32_t target = (total * p + 99) / 100;
+    uint32_t sum = 0;
+    for (uint8_t i = 0; i < STATS_BUCKETS - 1; i++)
+    {
+      sum += this->buckets_[i];
+      if (sum >= target)
+      {
+        return std::min(bucket_start(i + 1) - 1, this->max);
+      }
+    }
+    return this->max;
+  }
+
+  void EHMTX_Histogram::reset()
+  {
+    memset(this->buckets_, 0, sizeof(this->buckets_));
+    this->count = 0;
+    this->max = 0;
+  }
+
+  EHMTX_ServiceTimer::EHMTX_ServiceTimer(EHMTX *config, const char *name)
+  {
+    this->config_ = config;
+    this->name_ = name;
+    this->start_ = micros();
+    this->outer_ = (config->service_depth++ == 0) && (name != nullptr);
+#ifdef EHMTXv2_COUNT_ALLOCATIONS
+    this->allocations_ = EHMTX_allocations;
+#endif
+  }
+
+  EHMTX_ServiceTimer::~EHMTX_ServiceTimer()
+  {
+    if ((--this->config_->service_depth > 0) || (this->name_ == nullptr))
+    {
+      return;
+    }
+    uint32_t us = micros() - this->start_;
+#ifdef EHMTXv2_STATS
+    this->config_->service_time.add(us);
+#endif
+#ifdef EHMTXv2_COUNT_ALLOCATIONS
+    this->config_->service_allocations += EHMTX_allocations - this->allocations_;
+#endif
+#ifdef EHMTXv2_PERSIST_SIZE
+    this->config_->persist_changed();
+#endif
+    if (us >= this->config_->slowest_service_time)
+    {
+      this->config_->slowest_service_time = us;
+      this->config_->slowest_service = this->name_;
+    }
+  }
+
+  // called at the start of tick(), frames later than 1.5 display intervals are late
+  void EHMTX::frame_started(uint32_t now)
+  {
+    uint32_t interval = this->display->get_update_interval() * 1000;
+    if ((this->last_frame_start_ != 0) && (interval > 0))
+    {
+      uint32_t elapsed = now - this->last_frame_start_;
+      if (elapsed > interval + interval / 2)
+      {
+        this->late_frames++;
+        this->dropped_frames += (elapsed + interval / 2) / interval - 1;
+      }
+    }
+    this->last_frame_start_ = now;
+  }
+
+  uint8_t EHMTX::queue_occupied()
+  {
+    uint8_t occupied = 0;
+    for (uint8_t i = 0; i < MAXQUEUE; i++)
+    {
+      if (this->queue[i]->mode != MODE_EMPTY)
+      {
+        occupied++;
+      }
+    }
+    return occupied;
+  }
+
+  // screen is about to be filled by find_free_queue_element()
+  void EHMTX::queue_inserted(EHMTX_queue *screen)
+  {
+    this->queue_inserts++;
+    this->queue_peak = std::max<uint8_t>(this->queue_peak, this->queue_occupied() + (screen->mode == MODE_EMPTY ? 1 : 0));
+    screen->added_time = millis();
+    screen->waiting = true;
+    screen->restored = false;
+  }
+
+  // called by tick() when screen_pointer changed from previous
+  void EHMTX::screen_started(uint8_t previous)
+  {
+    uint32_t now = millis();
+#ifdef EHMTXv2_STATS
+    if ((previous < MAXQUEUE) && (this->screen_start_ != 0))
+    {
+      this->dwell_time.add(now - this->screen_start_);
+    }
+#endif
+    this->screen_start_ = now;
+
+    EHMTX_queue *screen = this->queue[this->screen_pointer];
+    if (screen->waiting)
+    {
+#ifdef EHMTXv2_STATS
+      this->wait_time.add(now - screen->added_time);
+#endif
+      screen->waiting = false;
+    }
+  }
+
+#ifdef EHMTXv2_STATS
+  void EHMTX::set_stats_interval(uint32_t ms)
+  {
+    this->stats_interval_ = ms;
+  }
+
+#ifdef USE_SENSOR
+  void EHMTX::set_stat_sensor(uint8_t stat, sensor::Sensor *sensor)
+  {
+    if (stat < STAT_COUNT)
+    {
+      this->stat_sensors_[stat] = sensor;
+    }
+  }
+#endif
+#endif
+
+  void EHMTX::stats_status()
+  {
+#ifdef EHMTXv2_STATS
+    ESP_LOGI(TAG, "status tick: p50: %d p95: %d max: %d µs (%d frames)", this->tick_time.percentile(50),
+             this->tick_time.percentile(95), this->tick_time.max, this->tick_time.count);
+    ESP_LOGI(TAG, "status draw: p50: %d p95: %d max: %d µs", this->draw_time.percentile(50),
+             this->draw_time.percentile(95), this->draw_time.max);
+#endif
+    ESP_LOGI(TAG, "status late frames: %d dropped frames: %d", this->late_frames, this->dropped_frames);
+#ifdef EHMTXv2_STATS
+    if (this->service_time.count > 0)
+    {
+      ESP_LOGI(TAG, "status services: p50: %d p95: %d max: %d µs (%d calls, slowest: %s)",
+               this->service_time.percentile(50), this->service_time.percentile(95), this->service_time.max,
+               this->service_time.count, this->slowest_service);
+    }
+#else
+    ESP_LOGI(TAG, "status slowest service: %s (%d µs)", this->slowest_service, this->slowest_service_time);
+#endif
+    ESP_LOGI(TAG, "status queue: %d of %d slots occupied, peak: %d", this->queue_occupied(), MAXQUEUE, this->queue_peak);
+    ESP_LOGI(TAG, "status queue: inserts: %d updates: %d evictions: %d expiries: %d forced: %d skipped: %d",
+             this->queue_inserts, this->queue_updates, this->queue_evictions, this->queue_expiries,
+             this->forced_screens, this->skipped_screens);
+#ifdef EHMTXv2_STATS
+    ESP_LOGI(TAG, "status wait: p50: %.1f p95: %.1f max: %.1f s", this->wait_time.percentile(50) / 1000.0f,
+             this->wait_time.percentile(95) / 1000.0f, this->wait_time.max / 1000.0f);
+    ESP_LOGI(TAG, "status dwell: p50: %.1f p95: %.1f max: %.1f s", this->dwell_time.percentile(50) / 1000.0f,
+             this->dwell_time.percentile(95) / 1000.0f, this->dwell_time.max / 1000.0f);
+#endif
+#ifdef EHMTXv2_FRAME_CACHE
+    ESP_LOGI(TAG, "status frame cache: %d hits %d misses (%.1f%%)", this->frame_cache.hits, this->frame_cache.misses,
+             this->frame_cache_hit_rate());
+#endif
+#ifdef EHMTXv2_COUNT_ALLOCATIONS
+    ESP_LOGI(TAG, "status allocations: frames: %d services: %d", this->frame_allocations, this->service_allocations);
+#endif
+    ESP_LOGI(TAG, "status events: %d waiting, coalesced: %d dropped: %d", this->events_.size(), this->coalesced_events,
+             this->dropped_events);
+#ifdef EHMTXv2_PERSIST_SIZE
+    ESP_LOGI(TAG, "status persist: %d screens restored, %d snapshots written", this->restored_screens, this->persist_writes);
+#endif
+#ifdef EHMTXv2_RENDER_TASK
+    ESP_LOGI(TAG, "status render task: %d commands waiting, dropped: %d", this->commands_.size(), this->dropped_commands);
+#endif
+  }
+
+#ifdef EHMTXv2_STATS
+  // the values of the measurement window and a new window, called from update() where tick() runs
+  void EHMTX::take_stats()
+  {
+    if (millis() - this->last_stats_time_ < this->stats_interval_)
+    {
+      return;
+    }
+    this->last_stats_time_ = millis();
+
+#ifdef EHMTXv2_FRAME_CACHE
+    float frame_cache_hits = this->frame_cache_hit_rate();
+#else
+    float frame_cache_hits = NAN;
+#endif
+#ifdef EHMTXv2_RENDER_TASK
+    EHMTX_Stats *stats = this->stats_.back();
+#else
+    EHMTX_Stats *stats = &this->stats_;
+#endif
+    *stats = {{
+        (float)this->tick_time.percentile(50), (float)this->tick_time.percentile(95), (float)this->tick_time.max,
+        (float)this->draw_time.percentile(50), (float)this->draw_time.percentile(95), (float)this->draw_time.max,
+        (float)this->service_time.percentile(50), (float)this->service_time.percentile(95), (float)this->service_time.max,
+        (float)this->late_frames, (float)this->dropped_frames,
+        (float)this->queue_occupied(), (float)this->queue_peak, (float)this->queue_inserts, (float)this->queue_updates,
+        (float)this->queue_evictions, (float)this->queue_expiries, (float)this->forced_screens, (float)this->skipped_screens,
+        this->wait_time.percentile(50) / 1000.0f, this->wait_time.percentile(95) / 1000.0f, this->wait_time.max / 1000.0f,
+        this->dwell_time.percentile(50) / 1000.0f, this->dwell_time.percentile(95) / 1000.0f, this->dwell_time.max / 1000.0f,
+        frame_cache_hits, (float)this->dropped_events}};
+#ifdef EHMTXv2_RENDER_TASK
+    this->stats_.publish();
+#else
+    this->stats_fresh_ = true;
+#endif
+
+    this->tick_time.reset();
+    this->draw_time.reset();
+    this->service_time.reset();
+    this->late_frames = 0;
+    this->dropped_frames = 0;
+    this->slowest_service = "";
+    this->slowest_service_time = 0;
+
+    this->wait_time.reset();
+    this->dwell_time.reset();
+    this->queue_inserts = 0;
+    this->queue_updates = 0;
+    this->queue_evictions = 0;
+    this->queue_expiries = 0;
+    this->forced_screens = 0;
+    this->skipped_screens = 0;
+    this->dropped_events = 0;
+    this->coalesced_events = 0;
+#ifdef EHMTXv2_COUNT_ALLOCATIONS
+    this->frame_allocations = 0;
+    this->service_allocations = 0;
+#endif
+    this->queue_peak = this->queue_occupied();
+#ifdef EHMTXv2_FRAME_CACHE
+    this->frame_cache.hits = 0;
+    this->frame_cache.misses = 0;
+#endif
+  }
+
+  // main loop, the sensors get the values of the last take_stats()
+  void EHMTX::publish_stats()
+  {
+#ifdef EHMTXv2_RENDER_TASK
+    if (this->in_render_task())
+    {
+      return;
+    }
+    EHMTX_Stats *stats = this->stats_.fresh();
+#else
+    EHMTX_Stats *stats = this->stats_fresh_ ? &this->stats_ : nullptr;
+    this->stats_fresh_ = false;
+#endif
+    if (stats == nullptr)
+    {
+      return;
+    }
+#ifdef USE_SENSOR
+    for (uint8_t i = 0; i < STAT_COUNT; i++)
+    {
+      if (this->stat_sensors_[i] != nullptr)
+      {
+        this->stat_sensors_[i]->publish_state(stats->values[i]);
+      }
+    }
+#endif
+    ESP_LOGD(TAG, "frame stats: tick p95: %d µs draw p95: %d µs late frames: %d", (int)stats->values[STAT_TICK_P95],
+             (int)stats->values[STAT_DRAW_P95], (int)stats->values[STAT_LATE_FRAMES]);
+  }
+#endif
+
+#ifdef EHMTXv2_FRAME_CACHE
+  // percent of the icon frames drawn from RAM
+  float EHMTX::frame_cache_hit_rate()
+  {
+    uint32_t total = this->frame_cache.hits + this->frame_cache.misses;
+    return total > 0 ? 100.0f * this->frame_cache.hits / total : NAN;
+  }
+#endif
+}
@@ -0,0 +1,130 @@
+#include "esphome.h"
+
+namespace esphome
+{
+
+  void EHMTX_TextRun::clear()
+  {
+    this->glyphs.clear();
+    this->spans.clear();
+    this->icons.clear();
+    this->width = 0;
+  }
+
+  static int8_t hex_digit(char c)
+  {
+    if ((c >= '0') && (c <= '9'))
+      return c - '0';
+    if ((c >= 'a') && (c <= 'f'))
+      return c - 'a' + 10;
+    if ((c >= 'A') && (c <= 'F'))
+      return c - 'A' + 10;
+    return -1;
+  }
+
+  // #rrggbb
+  static bool parse_color(const char *tag, size_t length, Color &color)
+  {
+    if ((length != 7) || (tag[0] != '#'))
+    {
+      return false;
+    }
+    uint8_t rgb[3];
+    for (uint8_t i = 0; i < 3; i++)
+    {
+      int8_t high = hex_digit(tag[1 + 2 * i]);
+      int8_t low = hex_digit(tag[2 + 2 * i]);
+      if ((high < 0) || (low < 0))
+      {
+        return false;
+      }
+      rgb[i] = (high << 4) | low;
+    }
+    color = Color(rgb[0], rgb[1], rgb[2]);
+    return true;
+  }
+
+  // decode the UTF-8 text and look up every glyph once, same metrics as font::Font::measure()
+  // with markup the tags [icon:name], [#rrggbb] and [/] become icons and color spans, [[ is a [,
+  // other brackets and icons that are not found stay text
+  void EHMTX_TextRun::shape(font::Font *font, const std::string &text, EHMTX *markup)
+  {
+    int x1, y1, w, h;
+    int x = 0;
+    int min_x = 0;
+    bool has_char = false;
+    const char *str = text.c_str();
+
+    this->clear();
+    this->glyphs.reserve(text.length());
+
+    int i = 0;
+    while (str[i] != '\0')
+    {
+      if ((markup != nullptr) && (str[i] == '['))
+      {
+        const char *close = strchr(str + i + 1, ']');
+        const char *tag = str + i + 1;
+        size_t length = (close != nullptr) ? close - tag : 0;
+        Color color;
+        if (str[i + 1] == '[')
+        {
+          i++;
+        }
+        else if ((length == 1) && (tag[0] == '/'))
+        {
+          this->spans.push_back({(uint16_t)this->glyphs.size(), false, Color()});
+          i += length + 2;
+          continue;
+        }
+        else if (parse_color(tag, length, color))
+        {
+          this->spans.push_back({(uint16_t)this->glyphs.size(), true, color});
+          i += length + 2;
+          continue;
+        }
+        else if ((length > 5) && (strncmp(tag, "icon:", 5) == 0))
+        {
+          uint8_t icon = markup->find_icon(std::string(tag + 5, length - 5), false);
+          if (icon < markup->icon_count)
+          {
+            min_x = has_char ? std::min(min_x, x) : x;
+            this->icons.push_back({(int16_t)x, icon});
+            x += markup->icons[icon]->get_width() + 1;
+            i += length + 2;
+            has_char = true;
+            continue;
+          }
+        }
+      }
+      int match_length;
+      int glyph_n = font->match_next_glyph(str + i, &match_length);
+      if (glyph_n < 0)
+      {
+        // unknown char, font::Font::print() draws a box with the width of the first glyph
+        if (!font->get_glyphs().empty())
+        {
+          font->get_glyphs()[0].scan_area(&x1, &y1, &w, &h);
+          this->glyphs.push_back({-1, (int16_t)x});
+          x += w;
+        }
+        i++;
+        continue;
+      }
+      font->get_glyphs()[glyph_n].scan_area(&x1, &y1, &w, &h);
+      if (!has_char)
+      {
+        min_x = x1;
+      }
+      else
+      {
+        min_x = std::min(min_x, x + x1);
+      }
+      this->glyphs.push_back({(int16_t)glyph_n, (int16_t)x});
+      x += w + x1;
+      i += match_length;
+      has_char = true;
+    }
+    this->width = x - min_x;
+  }
+}
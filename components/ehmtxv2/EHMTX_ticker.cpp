@@ -0,0 +1,185 @@
+#include "esphome.h"
+
+namespace esphome
+{
+  // the segments are shaped with this font, they are dropped when it changes, the x offset is added when drawing
+  void EHMTX_Ticker::set_font(font::Font *font, EHMTX_FontAtlas *atlas, int8_t xoffset)
+  {
+    this->xoffset_ = xoffset;
+    if ((font != this->font_) || (atlas != this->atlas_))
+    {
+      this->clear();
+      this->font_ = font;
+      this->atlas_ = atlas;
+    }
+  }
+
+  void EHMTX_Ticker::clear()
+  {
+    this->first_ = 0;
+    this->count_ = 0;
+    this->offset_ = 0;
+  }
+
+  // a new segment follows the last one without a gap, an empty ticker starts at the right edge
+  void EHMTX_Ticker::append(const std::string &text, Color color)
+  {
+    if ((this->font_ == nullptr) || text.empty())
+    {
+      return;
+    }
+    if (this->count_ == TICKER_SEGMENTS)
+    {
+      ESP_LOGW(TAG, "ticker full, oldest text dropped");
+      this->dropped++;
+      this->drop();
+    }
+    int32_t start = this->offset_;
+    if (this->count_ > 0)
+    {
+      Segment &last = this->segments_[(this->first_ + this->count_ - 1) % TICKER_SEGMENTS];
+      start = std::max<int32_t>(start, last.start + last.run.width);
+    }
+    Segment &segment = this->segments_[(this->first_ + this->count_) % TICKER_SEGMENTS];
+    segment.run.shape(this->font_, text);
+    segment.start = start;
+    segment.color = color;
+    this->count_++;
+  }
+
+  // the first segment leaves the ring, the positions are moved so the offset can't overflow
+  void EHMTX_Ticker::drop()
+  {
+    this->first_ = (this->first_ + 1) % TICKER_SEGMENTS;
+    this->count_--;
+    if (this->count_ == 0)
+    {
+      this->offset_ = 0;
+      return;
+    }
+    int32_t shift = this->segments_[this->first_].start;
+    for (uint8_t i = 0; i < this->count_; i++)
+    {
+      this->segments_[(this->first_ + i) % TICKER_SEGMENTS].start -= shift;
+    }
+    this->offset_ -= shift;
+  }
+
+  // one pixel per scroll interval since the screen was shown at since, the segments left of the matrix are dropped
+  void EHMTX_Ticker::scroll(uint32_t since)
+  {
+    uint32_t now = millis();
+    if ((int32_t)(since - this->last_step_) > 0)
+    {
+      this->last_step_ = since;
+    }
+    uint32_t steps = (now - this->last_step_) / EHMTXv2_SCROLL_INTERVALL;
+    this->offset_ += steps;
+    this->last_step_ += steps * EHMTXv2_SCROLL_INTERVALL;
+
+    while (this->count_ > 0)
+    {
+      Segment &first = this->segments_[this->first_];
+      if (MATRIX_WIDTH + first.start + first.run.width - this->offset_ + this->xoffset_ > 0)
+      {
+        break;
+      }
+      this->drop();
+    }
+  }
+
+  void EHMTX_Ticker::draw(display::DisplayBuffer *display)
+  {
+    for (uint8_t i = 0; i < this->count_; i++)
+    {
+      Segment &segment = this->segments_[(this->first_ + i) % TICKER_SEGMENTS];
+      int32_t x = MATRIX_WIDTH + segment.start - this->offset_ + this->xoffset_;
+      if (x >= MATRIX_WIDTH)
+      {
+        break;
+      }
+      this->atlas_->draw(display, segment.run, x, segment.color);
+    }
+  }
+
+  // cut at a char boundary, shrinking the string doesn't allocate
+  static void ticker_text(std::string &text)
+  {
+    if (text.length() > TICKER_CHARS)
+    {
+      size_t length = TICKER_CHARS;
+      while ((length > 0) && ((text[length] & 0xC0) == 0x80))
+      {
+        length--;
+      }
+      text.resize(length);
+    }
+  }
+
+  EHMTX_queue *EHMTX::find_ticker()
+  {
+    time_t ts = this->uptime();
+    for (uint8_t i = 0; i < MAXQUEUE; i++)
+    {
+      if ((this->queue[i]->mode == MODE_TICKER) && (this->queue[i]->endtime >= ts))
+      {
+        return this->queue[i];
+      }
+    }
+    return nullptr;
+  }
+
+  // there is one ticker, calling this again sets its lifetime, screen time, font and color and appends the text
+  void EHMTX::ticker_screen(std::string text, int lifetime, int screen_time, bool default_font, int r, int g, int b)
+  {
+    if (this->post(&EHMTX::ticker_screen, std::move(text), lifetime, screen_time, default_font, r, g, b))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "ticker_screen");
+    timer.trace(text, lifetime, screen_time, default_font, r, g, b);
+    EHMTX_queue *screen = this->find_ticker();
+    if (screen != nullptr)
+    {
+      this->diag(DIAG_SLOT_BY_ICON, screen->slot, screen->mode);
+      this->queue_updates++;
+      screen->added_time = millis();
+      screen->waiting = true;
+      screen->restored = false;
+    }
+    else
+    {
+      // the texts of an expired or deleted ticker are gone
+      this->ticker.clear();
+      screen = this->find_free_queue_element();
+    }
+
+    screen->endtime = this->uptime() + lifetime * 60;
+    screen->default_font = default_font;
+    screen->text_color = Color(r, g, b);
+    screen->mode = MODE_TICKER;
+    screen->prepare(screen_time);
+    ticker_text(text);
+    this->ticker.append(text, screen->text_color);
+    screen->diag(DIAG_SCREEN_ADDED);
+  }
+
+  // the text scrolls in after the texts already in the ticker, without a ticker one is added with the defaults
+  void EHMTX::ticker_append(std::string text)
+  {
+    if (this->post(&EHMTX::ticker_append, std::move(text)))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "ticker_append");
+    timer.trace(text);
+    EHMTX_queue *screen = this->find_ticker();
+    if (screen == nullptr)
+    {
+      this->ticker_screen(std::move(text));
+      return;
+    }
+    ticker_text(text);
+    this->ticker.append(text, screen->text_color);
+  }
+}
@@ -0,0 +1,186 @@
+#include "esphome.h"
+
+namespace esphome
+{
+  static const uint32_t TIMER_MAX_SECONDS = 99 * 3600 + 3599; // the most H:MM:SS shows
+
+  // glyph index and advance of an ASCII char, the same metrics as EHMTX_TextRun::shape()
+  static int16_t timer_glyph(font::Font *font, char c, int &advance)
+  {
+    char str[2] = {c, '\0'};
+    int length, x1, y1, w, h;
+    int glyph = font->match_next_glyph(str, &length);
+    if (glyph < 0)
+    {
+      advance = 0;
+      if (!font->get_glyphs().empty())
+      {
+        font->get_glyphs()[0].scan_area(&x1, &y1, &w, &h);
+        advance = w;
+      }
+      return -1;
+    }
+    font->get_glyphs()[glyph].scan_area(&x1, &y1, &w, &h);
+    advance = w + x1;
+    return glyph;
+  }
+
+  // H:MM:SS from one hour on and M:SS.t below, a countdown is rounded up so it shows zero only when it ends
+  void EHMTX_queue::timer_text(char *buffer, size_t size)
+  {
+    int32_t elapsed = (int32_t)(millis() - this->timer_ms);
+    uint32_t ms = elapsed;
+    if (!this->timer_up)
+    {
+      ms = (elapsed < 0) ? -elapsed : 0;
+      ms += (ms >= 3600000) ? 999 : 99;
+    }
+    uint32_t s = std::min<uint32_t>(ms / 1000, TIMER_MAX_SECONDS);
+    if (s >= 3600)
+    {
+      snprintf(buffer, size, "%u:%02u:%02u", (unsigned)(s / 3600), (unsigned)(s / 60 % 60), (unsigned)(s % 60));
+    }
+    else
+    {
+      snprintf(buffer, size, "%u:%02u.%u", (unsigned)(s / 60), (unsigned)(s % 60), (unsigned)(ms / 100 % 10));
+    }
+  }
+
+  // every digit is centered in a cell of digit_width_, so a new text looks up only the glyphs of the digits that
+  // changed, the whole text is laid out again when a separator moved
+  void EHMTX_queue::layout_timer(const char *text)
+  {
+    size_t length = strlen(text);
+    bool relayout = (length != this->run.glyphs.size());
+    for (size_t i = 0; (i < length) && !relayout; i++)
+    {
+      if ((text[i] != this->timer_text_[i]) && (!isdigit(text[i]) || !isdigit(this->timer_text_[i])))
+      {
+        relayout = true;
+      }
+    }
+
+    int advance;
+    if (relayout)
+    {
+      this->run.clear();
+      int x = 0;
+      for (size_t i = 0; i < length; i++)
+      {
+        int16_t glyph = timer_glyph(this->font_, text[i], advance);
+        if (isdigit(text[i]))
+        {
+          this->run.glyphs.push_back({glyph, (int16_t)(x + (this->digit_width_ - advance) / 2)});
+          x += this->digit_width_;
+        }
+        else
+        {
+          this->run.glyphs.push_back({glyph, (int16_t)x});
+          x += advance;
+        }
+      }
+      this->run.width = x;
+    }
+    else
+    {
+      for (size_t i = 0; i < length; i++)
+      {
+        if (text[i] != this->timer_text_[i])
+        {
+          timer_glyph(this->font_, this->timer_text_[i], advance);
+          int cell = this->run.glyphs[i].x - (this->digit_width_ - advance) / 2;
+          int16_t glyph = timer_glyph(this->font_, text[i], advance);
+          this->run.glyphs[i] = {glyph, (int16_t)(cell + (this->digit_width_ - advance) / 2)};
+        }
+      }
+    }
+    strncpy(this->timer_text_, text, sizeof(this->timer_text_) - 1);
+    this->timer_text_[sizeof(this->timer_text_) - 1] = '\0';
+  }
+
+  EHMTX_queue *EHMTX::find_timer_queue_element(const std::string &icon_name)
+  {
+    time_t ts = this->uptime();
+    for (uint8_t i = 0; i < MAXQUEUE; i++)
+    {
+      EHMTX_queue *screen = this->queue[i];
+      if ((screen->mode == MODE_TIMER) && (screen->endtime >= ts) && (screen->icon_name == icon_name))
+      {
+        this->diag(DIAG_SLOT_BY_ICON, i, screen->mode, screen->icon);
+        this->queue_updates++;
+        screen->added_time = millis();
+        screen->waiting = true;
+        screen->restored = false;
+        return screen;
+      }
+    }
+    return this->find_free_queue_element();
+  }
+
+  // one timer per icon_name, starting it again restarts it, the lifetime of a countdown starts when it ends
+  void EHMTX::add_timer(std::string icon_name, uint32_t ms, bool up, int lifetime, int screen_time, bool default_font, Color color)
+  {
+    EHMTX_queue *screen = this->find_timer_queue_element(icon_name);
+    screen->timer_ms = millis() + ms;
+    screen->timer_up = up;
+    screen->timer_done = false;
+    screen->endtime = this->uptime() + ms / 1000 + lifetime * 60;
+    screen->default_font = default_font;
+    screen->text_color = color;
+    screen->icon_name = std::move(icon_name);
+    screen->mode = MODE_TIMER;
+    screen->prepare(screen_time);
+    this->queue_event(EVENT_ADD_SCREEN, screen->icon_name, "", screen->mode);
+    screen->diag(DIAG_SCREEN_ADDED);
+  }
+
+  // counts down from seconds, 0 starts a stopwatch
+  void EHMTX::timer_screen(std::string icon_name, int seconds, int lifetime, int screen_time, bool default_font, int r, int g, int b)
+  {
+    if (this->post(&EHMTX::timer_screen, std::move(icon_name), seconds, lifetime, screen_time, default_font, r, g, b))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "timer_screen");
+    timer.trace(icon_name, seconds, lifetime, screen_time, default_font, r, g, b);
+    uint32_t s = std::min<uint32_t>(std::max(seconds, 0), TIMER_MAX_SECONDS);
+    this->add_timer(std::move(icon_name), s * 1000, s == 0, lifetime, screen_time, default_font, Color(r, g, b));
+  }
+
+  // counts down to a unix timestamp, the remaining time is taken from the clock once, then it runs on millis()
+  void EHMTX::timer_until(std::string icon_name, int timestamp, int lifetime, int screen_time, bool default_font, int r, int g, int b)
+  {
+    if (this->post(&EHMTX::timer_until, std::move(icon_name), timestamp, lifetime, screen_time, default_font, r, g, b))
+    {
+      return;
+    }
+    EHMTX_ServiceTimer timer(this, "timer_until");
+    timer.trace(icon_name, timestamp, lifetime, screen_time, default_font, r, g, b);
+    if (!this->clock->now().is_valid())
+    {
+      ESP_LOGW(TAG, "timer_until: no valid time, timer %s not started", icon_name.c_str());
+      return;
+    }
+    time_t seconds = std::max<time_t>((time_t)timestamp - this->clock->now().timestamp, 0);
+    uint32_t s = std::min<time_t>(seconds, TIMER_MAX_SECONDS);
+    this->add_timer(std::move(icon_name), s * 1000, false, lifetime, screen_time, default_font, Color(r, g, b));
+  }
+
+  // called from update(), on_timer_done comes within a polling interval after zero, also when the timer isn't shown
+  void EHMTX::check_timers()
+  {
+    time_t ts = this->uptime();
+    uint32_t now = millis();
+    for (uint8_t i = 0; i < MAXQUEUE; i++)
+    {
+      EHMTX_queue *screen = this->queue[i];
+      if ((screen->mode == MODE_TIMER) && (screen->endtime >= ts) && !screen->timer_up && !screen->timer_done &&
+          ((int32_t)(now - screen->timer_ms) >= 0))
+      {
+        ESP_LOGD(TAG, "timer %s done", screen->icon_name.c_str());
+        screen->timer_done = true;
+        this->queue_event(EVENT_TIMER_DONE, screen->icon_name, "", screen->mode);
+      }
+    }
+  }
+}
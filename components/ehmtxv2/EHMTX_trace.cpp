@@ -0,0 +1,158 @@
+#include "esphome.h"
+
+#ifdef EHMTXv2_TRACE_SIZE
+namespace esphome
+{
+
+  void EHMTX_ServiceTimer::trace_arg(std::string &record, const std::string &value)
+  {
+    record += '"';
+    for (char c : value)
+    {
+      if ((c == '"') || (c == '\\'))
+      {
+        record += '\\';
+      }
+      if (c == '\n')
+      {
+        record += "\\n";
+        continue;
+      }
+      record += c;
+    }
+    record += '"';
+  }
+
+  void EHMTX_ServiceTimer::trace_arg(std::string &record, int value)
+  {
+    record += std::to_string(value);
+  }
+
+  void EHMTX_ServiceTimer::trace_arg(std::string &record, bool value)
+  {
+    record += value ? "true" : "false";
+  }
+
+  void EHMTX_ServiceTimer::trace_arg(std::string &record, float value)
+  {
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%g", value);
+    record += buffer;
+  }
+
+  // the ring holds complete records separated by '\n', the oldest ones are dropped to make room
+  void EHMTX::trace_append(const std::string &record)
+  {
+    uint32_t length = record.length() + 1;
+    if (length > EHMTXv2_TRACE_SIZE)
+    {
+      this->trace_dropped_++;
+      return;
+    }
+    while (EHMTXv2_TRACE_SIZE - this->trace_used_ < length)
+    {
+      char c;
+      do
+      {
+        c = this->trace_[this->trace_head_];
+        this->trace_head_ = (this->trace_head_ + 1) % EHMTXv2_TRACE_SIZE;
+        this->trace_used_--;
+      } while (c != '\n');
+      this->trace_dropped_++;
+    }
+    uint32_t tail = (this->trace_head_ + this->trace_used_) % EHMTXv2_TRACE_SIZE;
+    for (uint32_t i = 0; i < length; i++)
+    {
+      this->trace_[tail] = (i < record.length()) ? record[i] : '\n';
+      tail = (tail + 1) % EHMTXv2_TRACE_SIZE;
+    }
+    this->trace_used_ += length;
+  }
+
+  // one log line per record, long records are split into "trace +" continuation lines
+  void EHMTX::dump_trace()
+  {
+    if (this->post(&EHMTX::dump_trace))
+    {
+      return;
+    }
+    const uint8_t CHUNK = 200;
+    std::string line;
+    ESP_LOGI(TAG, "trace: %d bytes, %d records dropped", this->trace_used_, this->trace_dropped_);
+    for (uint32_t i = 0; i < this->trace_used_; i++)
+    {
+      char c = this->trace_[(this->trace_head_ + i) % EHMTXv2_TRACE_SIZE];
+      if (c != '\n')
+      {
+        line += c;
+        continue;
+      }
+      for (size_t start = 0; start < line.length(); start += CHUNK)
+      {
+        ESP_LOGI(TAG, "trace %c %s", start == 0 ? '>' : '+', line.substr(start, CHUNK).c_str());
+      }
+      line.clear();
+    }
+  }
+
+  void EHMTX::clear_trace()
+  {
+    if (this->post(&EHMTX::clear_trace))
+    {
+      return;
+    }
+    this->trace_head_ = 0;
+    this->trace_used_ = 0;
+    this->trace_dropped_ = 0;
+    ESP_LOGD(TAG, "trace cleared");
+  }
+}
+#endif
+
+#ifdef EHMTXv2_DIAG_SIZE
+namespace esphome
+{
+  static const char *const DIAG_NAMES[DIAG_EVENT_COUNT] = {"icon found", "icon in queue", "slot by icon", "free slot",
+                                                           "screen added", "next screen", "clock interval", "screen expired"};
+
+  // one log line per record, oldest first, the icon and screen type names are looked up now
+  void EHMTX::dump_diag()
+  {
+    if (this->post(&EHMTX::dump_diag))
+    {
+      return;
+    }
+    uint32_t count = std::min(this->diag_count_, (uint32_t)EHMTXv2_DIAG_SIZE);
+    ESP_LOGI(TAG, "diag: %d records, %d overwritten", count, this->diag_count_ - count);
+    for (uint32_t n = this->diag_count_ - count; n < this->diag_count_; n++)
+    {
+      const EHMTX_DiagRecord &r = this->diag_[n % EHMTXv2_DIAG_SIZE];
+      const char *name = (r.event < DIAG_EVENT_COUNT) ? DIAG_NAMES[r.event] : "unknown";
+      const char *icon = (r.icon < this->icon_count) ? this->icons[r.icon]->name.c_str() : "-";
+      if ((r.event == DIAG_SCREEN_ADDED) || (r.event == DIAG_NEXT_SCREEN) || (r.event == DIAG_SCREEN_EXPIRED))
+      {
+        ESP_LOGI(TAG, "diag %u ms %s: slot %d %s icon: %s for: %d sec text: %d px", r.ms, name, r.slot,
+                 EHMTX_queue::mode_name(r.mode), icon, r.value, r.value2);
+      }
+      else if (r.slot < MAXQUEUE)
+      {
+        ESP_LOGI(TAG, "diag %u ms %s: slot %d %s icon: %s", r.ms, name, r.slot, EHMTX_queue::mode_name(r.mode), icon);
+      }
+      else
+      {
+        ESP_LOGI(TAG, "diag %u ms %s: icon: %s (%d)", r.ms, name, icon, r.icon);
+      }
+    }
+  }
+
+  void EHMTX::clear_diag()
+  {
+    if (this->post(&EHMTX::clear_diag))
+    {
+      return;
+    }
+    this->diag_count_ = 0;
+    ESP_LOGD(TAG, "diag cleared");
+  }
+}
+#endif
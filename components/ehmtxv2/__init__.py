@@ -2,21 +2,22 @@ from argparse import Namespace
 import logging
 import io
 import json
-import requests
 
 from esphome import core, automation
-from esphome.components import display, font, time
+from esphome.components import display, font, time, sensor
 import esphome.components.image as espImage
 import esphome.config_validation as cv
 import esphome.codegen as cg
 from esphome.const import CONF_BLUE, CONF_GREEN, CONF_RED, CONF_RESIZE, CONF_FILE, CONF_ID, CONF_BRIGHTNESS, CONF_RAW_DATA_ID,  CONF_TIME, CONF_TRIGGER_ID
+from esphome.const import ENTITY_CATEGORY_DIAGNOSTIC, STATE_CLASS_MEASUREMENT
 from esphome.core import CORE, HexInt
 from esphome.cpp_generator import RawExpression
+from .icon_cache import IconCache, IconCacheError, LAMETRIC_URL
 
 _LOGGER = logging.getLogger(__name__)
 
 DEPENDENCIES = ["display", "light", "api"]
-AUTO_LOAD = ["ehmtxv2","json"]
+AUTO_LOAD = ["ehmtxv2","sensor"]
 IMAGE_TYPE_RGB565 = 4
 MAXFRAMES = 110
 MAXICONS = 90
@@ -69,10 +70,15 @@ AddScreenTrigger = ehmtx_ns.class_(
     "EHMTXAddScreenTrigger", automation.Trigger.template(cg.std_string)
 )
 
+TimerDoneTrigger = ehmtx_ns.class_(
+    "EHMTXTimerDoneTrigger", automation.Trigger.template(cg.std_string)
+)
+
 CONF_URL = "url"
 CONF_FLAG = "flag"
 CONF_CLOCKINTERVAL = "clock_interval"
 CONF_ALWAYS_SHOW_RLINDICATORS = "always_show_rl_indicators"
+CONF_TEXT_MARKUP = "text_markup"
 CONF_TIMECOMPONENT = "time_component"
 CONF_LAMEID = "lameid"
 CONF_RGB565ARRAY = "str565"
@@ -83,9 +89,14 @@ CONF_SHOWDOW = "show_dow"
 CONF_SHOWDATE = "show_date"
 CONF_RTL = "rtl"
 CONF_FRAMEDURATION = "frame_duration"
+CONF_DURATIONS_ID = "durations_id"
 CONF_SCROLLCOUNT = "scroll_count"
 CONF_MATRIXCOMPONENT = "matrix_component"
 CONF_HTML = "icons2html"
+CONF_ICON_CACHE = "icon_cache"
+CONF_ICON_CACHE_TTL = "icon_cache_ttl"
+CONF_ICON_OFFLINE = "icon_offline"
+CONF_LAMEID_URL = "lameid_url"
 CONF_SCROLLINTERVAL = "scroll_interval"
 CONF_BLENDSTEPS = "blend_steps"
 CONF_RAINBOWINTERVAL = "rainbow_interval"
@@ -107,12 +118,101 @@ CONF_ON_NEXT_CLOCK = "on_next_clock"
 CONF_ON_ICON_ERROR = "on_icon_error"
 CONF_ON_ADD_SCREEN = "on_add_screen"
 CONF_ON_EXPIRED_SCREEN= "on_expired_screen"
+CONF_ON_TIMER_DONE = "on_timer_done"
 CONF_SHOW_SECONDS = "show_seconds"
 CONF_SCROLL_SMALL_TEXT = "scroll_small_text"
 CONF_ALLOW_EMPTY_SCREEN = "allow_empty_screen"
 CONF_WEEK_START_MONDAY = "week_start_monday"
 CONF_ICON = "icon_name"
 CONF_TEXT = "text"
+CONF_STATS_INTERVAL = "stats_interval"
+CONF_TRACE_SIZE = "trace_size"
+CONF_DIAG_SIZE = "diag_size"
+CONF_PERSIST_SIZE = "persist_size"
+CONF_PERSIST_INTERVAL = "persist_interval"
+CONF_TICK_TIME = "tick_time"
+CONF_DRAW_TIME = "draw_time"
+CONF_SERVICE_TIME = "service_time"
+CONF_LATE_FRAMES = "late_frames"
+CONF_DROPPED_FRAMES = "dropped_frames"
+CONF_QUEUE_OCCUPIED = "queue_occupied"
+CONF_QUEUE_PEAK = "queue_peak"
+CONF_QUEUE_INSERTS = "queue_inserts"
+CONF_QUEUE_UPDATES = "queue_updates"
+CONF_QUEUE_EVICTIONS = "queue_evictions"
+CONF_QUEUE_EXPIRIES = "queue_expiries"
+CONF_FORCED_SCREENS = "forced_screens"
+CONF_SKIPPED_SCREENS = "skipped_screens"
+CONF_WAIT_TIME = "wait_time"
+CONF_DWELL_TIME = "dwell_time"
+CONF_FRAME_CACHE_SIZE = "frame_cache_size"
+CONF_MATRIX_WIDTH = "matrix_width"
+CONF_MATRIX_HEIGHT = "matrix_height"
+CONF_RENDER_TASK = "render_task"
+CONF_COUNT_ALLOCATIONS = "count_allocations"
+CONF_FRAME_CACHE_HITS = "frame_cache_hits"
+CONF_DROPPED_EVENTS = "dropped_events"
+CONF_P50 = "p50"
+CONF_P95 = "p95"
+CONF_MAX = "max"
+
+# index of the first sensor in the stat_sensor enum (EHMTX.h), followed by p95 and max
+STAT_TIME_SENSORS = {CONF_TICK_TIME: 0, CONF_DRAW_TIME: 3, CONF_SERVICE_TIME: 6, CONF_WAIT_TIME: 19, CONF_DWELL_TIME: 22}
+STAT_FRAME_SENSORS = {CONF_LATE_FRAMES: 9, CONF_DROPPED_FRAMES: 10}
+STAT_QUEUE_SENSORS = {
+    CONF_QUEUE_OCCUPIED: 11,
+    CONF_QUEUE_PEAK: 12,
+    CONF_QUEUE_INSERTS: 13,
+    CONF_QUEUE_UPDATES: 14,
+    CONF_QUEUE_EVICTIONS: 15,
+    CONF_QUEUE_EXPIRIES: 16,
+    CONF_FORCED_SCREENS: 17,
+    CONF_SKIPPED_SCREENS: 18,
+}
+STAT_CACHE_SENSORS = {CONF_FRAME_CACHE_HITS: 25}
+STAT_EVENT_SENSORS = {CONF_DROPPED_EVENTS: 26}
+
+STAT_TIME_SCHEMA = cv.Schema({
+    cv.Optional(stat): sensor.sensor_schema(
+        unit_of_measurement="µs",
+        icon="mdi:timer-outline",
+        accuracy_decimals=0,
+        state_class=STATE_CLASS_MEASUREMENT,
+        entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+    ) for stat in [CONF_P50, CONF_P95, CONF_MAX]
+})
+
+STAT_SCREEN_TIME_SCHEMA = cv.Schema({
+    cv.Optional(stat): sensor.sensor_schema(
+        unit_of_measurement="s",
+        icon="mdi:timer-sand",
+        accuracy_decimals=1,
+        state_class=STATE_CLASS_MEASUREMENT,
+        entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+    ) for stat in [CONF_P50, CONF_P95, CONF_MAX]
+})
+
+STAT_QUEUE_SCHEMA = sensor.sensor_schema(
+    icon="mdi:tray-full",
+    accuracy_decimals=0,
+    state_class=STATE_CLASS_MEASUREMENT,
+    entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+)
+
+STAT_CACHE_SCHEMA = sensor.sensor_schema(
+    unit_of_measurement="%",
+    icon="mdi:memory",
+    accuracy_decimals=1,
+    state_class=STATE_CLASS_MEASUREMENT,
+    entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+)
+
+STAT_FRAME_SCHEMA = sensor.sensor_schema(
+    icon="mdi:timer-alert-outline",
+    accuracy_decimals=0,
+    state_class=STATE_CLASS_MEASUREMENT,
+    entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+)
 
 EHMTX_SCHEMA = cv.Schema({
     cv.Required(CONF_ID): cv.declare_id(EHMTX_),
@@ -126,6 +226,16 @@ EHMTX_SCHEMA = cv.Schema({
     cv.Optional(
         CONF_HTML, default=False
     ): cv.boolean,
+    cv.Optional(CONF_ICON_CACHE): cv.string,
+    cv.Optional(
+        CONF_ICON_CACHE_TTL, default="0s"
+    ): cv.positive_time_period_seconds,
+    cv.Optional(
+        CONF_ICON_OFFLINE, default=False
+    ): cv.boolean,
+    cv.Optional(
+        CONF_LAMEID_URL, default=LAMETRIC_URL
+    ): cv.url,
     cv.Optional(
         CONF_CLOCKFONT, default=True
     ): cv.boolean,
@@ -159,6 +269,9 @@ EHMTX_SCHEMA = cv.Schema({
     cv.Optional(
         CONF_ALWAYS_SHOW_RLINDICATORS, default=False
     ): cv.boolean,
+    cv.Optional(
+        CONF_TEXT_MARKUP, default=False
+    ): cv.boolean,
     cv.Optional(
         CONF_DATE_FORMAT, default="%d.%m."
     ): cv.string,
@@ -186,6 +299,44 @@ EHMTX_SCHEMA = cv.Schema({
         CONF_FRAMEINTERVAL, default="192"
     ): cv.templatable(cv.positive_int),
     cv.Optional(CONF_BRIGHTNESS, default=80): cv.templatable(cv.int_range(min=0, max=255)),
+    cv.Optional(CONF_STATS_INTERVAL): cv.positive_time_period_milliseconds,
+    cv.Optional(
+        CONF_FRAME_CACHE_SIZE, default="0"
+    ): cv.int_range(min=0, max=131072),
+    cv.Optional(
+        CONF_MATRIX_WIDTH, default="32"
+    ): cv.int_range(min=16, max=255),
+    cv.Optional(
+        CONF_MATRIX_HEIGHT, default="8"
+    ): cv.int_range(min=8, max=8),
+    cv.Optional(
+        CONF_TRACE_SIZE, default="0"
+    ): cv.int_range(min=0, max=65536),
+    cv.Optional(
+        CONF_DIAG_SIZE, default="64"
+    ): cv.int_range(min=0, max=4096),
+    cv.Optional(
+        CONF_PERSIST_SIZE, default="0"
+    ): cv.int_range(min=0, max=8192),
+    cv.Optional(
+        CONF_PERSIST_INTERVAL, default="60s"
+    ): cv.positive_time_period_milliseconds,
+    cv.Optional(
+        CONF_RENDER_TASK, default=False
+    ): cv.boolean,
+    cv.Optional(
+        CONF_COUNT_ALLOCATIONS, default=False
+    ): cv.boolean,
+    cv.Optional(CONF_TICK_TIME): STAT_TIME_SCHEMA,
+    cv.Optional(CONF_DRAW_TIME): STAT_TIME_SCHEMA,
+    cv.Optional(CONF_SERVICE_TIME): STAT_TIME_SCHEMA,
+    cv.Optional(CONF_LATE_FRAMES): STAT_FRAME_SCHEMA,
+    cv.Optional(CONF_DROPPED_FRAMES): STAT_FRAME_SCHEMA,
+    cv.Optional(CONF_WAIT_TIME): STAT_SCREEN_TIME_SCHEMA,
+    cv.Optional(CONF_DWELL_TIME): STAT_SCREEN_TIME_SCHEMA,
+    **{cv.Optional(key): STAT_QUEUE_SCHEMA for key in STAT_QUEUE_SENSORS},
+    cv.Optional(CONF_FRAME_CACHE_HITS): STAT_CACHE_SCHEMA,
+    cv.Optional(CONF_DROPPED_EVENTS): STAT_QUEUE_SCHEMA,
     cv.Optional(CONF_ON_NEXT_SCREEN): automation.validate_automation(
         {
             cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(NextScreenTrigger),
@@ -222,6 +373,11 @@ EHMTX_SCHEMA = cv.Schema({
             cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(ExpiredScreenTrigger),
         }
     ),
+    cv.Optional(CONF_ON_TIMER_DONE): automation.validate_automation(
+        {
+            cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(TimerDoneTrigger),
+        }
+    ),
     cv.Required(CONF_ICONS): cv.All(
         cv.ensure_list(
             {
@@ -239,76 +395,66 @@ EHMTX_SCHEMA = cv.Schema({
                     CONF_PINGPONG, default=False
                 ): cv.boolean,
                 cv.GenerateID(CONF_RAW_DATA_ID): cv.declare_id(cg.uint8),
+                cv.GenerateID(CONF_DURATIONS_ID): cv.declare_id(cg.uint16),
             }
         ),
         cv.Length(max=MAXICONS),
     )})
 
-CONFIG_SCHEMA = cv.All(font.validate_pillow_installed, EHMTX_SCHEMA)
-
-CODEOWNERS = ["@lubeda"]
-
-async def to_code(config):
+def validate_render_task(config):
+    # the task runs on the core the main loop does not use
+    if config[CONF_RENDER_TASK] and not CORE.is_esp32:
+        raise cv.Invalid(f"{CONF_RENDER_TASK} needs an ESP32")
+    return config
 
-    from PIL import Image, ImageSequence
+def validate_persist_size(config):
+    # the ESP8266 keeps all flash preferences in 512 bytes
+    size = config[CONF_PERSIST_SIZE]
+    if 0 < size < 64:
+        raise cv.Invalid(f"{CONF_PERSIST_SIZE} needs at least 64 bytes")
+    if CORE.is_esp8266 and size > 256:
+        raise cv.Invalid(f"{CONF_PERSIST_SIZE} can't exceed 256 bytes on an ESP8266")
+    return config
 
-    def openImageFile(path):
-        try:
-            return Image.open(path)
-        except Exception as e:
-            raise core.EsphomeError(f" ICONS: Could not load image file {path}: {e}")
+CONFIG_SCHEMA = cv.All(font.validate_pillow_installed, EHMTX_SCHEMA, validate_render_task, validate_persist_size)
 
-    def thumbnails(frames):
-        for frame in frames:
-            thumbnail = frame.copy()
-            thumbnail.thumbnail((32,8), Image.ANTIALIAS)
-            yield thumbnail
+CODEOWNERS = ["@lubeda"]
 
-    var = cg.new_Pvariable(config[CONF_ID])
+async def to_code(config):
 
-    logging.info(f"Preparing icons, this may take some seconds.")
+    from PIL import Image, ImageChops
 
-    html_string = F"<HTML><HEAD><TITLE>{CORE.config_path}</TITLE></HEAD>"
-    html_string += '''\
-    <STYLE>
-    svg { padding-top: 2x; padding-right: 2px; padding-bottom: 2px; padding-left: 2px; }
-    </STYLE><BODY>\
-'''
+    # rgb565 big endian, the high byte is rrrrrggg and the low byte gggbbbbb
+    LUT_R_HIGH = [v & 0xF8 for v in range(256)]
+    LUT_G_HIGH = [v >> 5 for v in range(256)]
+    LUT_G_LOW = [(v << 3) & 0xE0 for v in range(256)]
+    LUT_B_LOW = [v >> 3 for v in range(256)]
 
-    yaml_string= ""
+    def rgb565_frame(frame):
+        r, g, b = frame.split()
+        # the bits don't overlap, so add() can't clip
+        high = ImageChops.add(r.point(LUT_R_HIGH), g.point(LUT_G_HIGH))
+        low = ImageChops.add(g.point(LUT_G_LOW), b.point(LUT_B_LOW))
+        return Image.merge("LA", (high, low)).tobytes()
 
-    for conf in config[CONF_ICONS]:
-                
-        if CONF_FILE in conf:
-            path = CORE.relative_config_path(conf[CONF_FILE])
-            try:
-                image = openImageFile(path)
-            except Exception as e:
-                raise core.EsphomeError(f" ICONS: Could not load image file {path}: {e}")
-        elif CONF_LAMEID in conf:
-            r = requests.get("https://developer.lametric.com/content/apps/icon_thumbs/" + conf[CONF_LAMEID], timeout=4.0)
-            if r.status_code != requests.codes.ok:
-                raise core.EsphomeError(f" ICONS: Could not download image file {conf[CONF_LAMEID]}: {conf[CONF_ID]}")
-            image = Image.open(io.BytesIO(r.content))
-        elif CONF_URL in conf:
-            r = requests.get(conf[CONF_URL], timeout=4.0)
-            if r.status_code != requests.codes.ok:
-                raise core.EsphomeError(f" ICONS: Could not download image file {conf[CONF_URL]}: {conf[CONF_ID]}")
-            image = Image.open(io.BytesIO(r.content))
-        elif CONF_RGB565ARRAY in conf:
+    def load_image(conf, source):
+        if CONF_RGB565ARRAY in conf:
             r = list(json.loads(conf[CONF_RGB565ARRAY]))
             if len(r) == 64:
                 image = Image.new("RGB",[8,8])
-                for y in range(0,8):
-                   for x in range(0,8):
-                        image.putpixel((x,y),rgb565_888(r[x+y*8]))
             elif len(r) == 256:
                 image = Image.new("RGB",[32,8])
-                for y in range(0,8):
-                    for x in range(0,32):
-                        image.putpixel((x,y),rgb565_888(r[x+y*32]))
-                        
-                           
+            else:
+                raise core.EsphomeError(f" ICONS: {conf[CONF_ID]}: {CONF_RGB565ARRAY} needs 64 or 256 values")
+            image.putdata([rgb565_888(v) for v in r])
+            return image
+        try:
+            return Image.open(io.BytesIO(source))
+        except Exception as e:
+            raise core.EsphomeError(f" ICONS: Could not load image file {conf[CONF_ID]}: {e}")
+
+    def convert_icon(conf, source):
+        image = load_image(conf, source)
         width, height = image.size
 
         if CONF_RESIZE in conf:
@@ -322,86 +468,158 @@ async def to_code(config):
             frames = 1
 
         if ((width != 4*ICONWIDTH) or (width != ICONWIDTH)) and (height != ICONHEIGHT):
-            logging.warning(f" icon wrong size valid 8x8 or 8x32: {conf[CONF_ID]} skipped!")
-        else:
+            return None
+
+        data = bytearray(ICONBUFFERSIZE * 2 * frames)
+        durations = []
+        pos = 0
+        for frameIndex in range(frames):
+            image.seek(frameIndex)
             if (conf[CONF_FRAMEDURATION] == 0):
-                try:
-                    duration =  image.info['duration']         
-                except:
-                    duration = config[CONF_FRAMEINTERVAL]
+                # gifs store the delay of each frame, 0 means as fast as possible
+                durations.append(image.info.get('duration') or config[CONF_FRAMEINTERVAL])
             else:
-                duration = conf[CONF_FRAMEDURATION]
-
-            html_string += F"<BR><B>{conf[CONF_ID]}</B>&nbsp;-&nbsp;({duration} ms):<BR>"
-            yaml_string += F"\"{conf[CONF_ID]}\","
-            pos = 0 
-            frameIndex = 0
-            html_string += f"<DIV ID={conf[CONF_ID]}>"
-            data = [0 for _ in range(ICONBUFFERSIZE * 2 * frames)]
-            for frameIndex in range(frames):
-                
-                image.seek(frameIndex)
-                frame = image.convert("RGB")
-                if CONF_RESIZE in conf:
-                    frame = frame.resize([width, height])
-
-                pixels = list(frame.getdata())
-
-                
-                # width, height = image.size
-                if width == 8:  
-                    html_string += SVG_ICONSTART
-                else:
-                    html_string += SVG_FULL_SCREEN_START
-                i = 0
-                for pix in pixels:
-                    R = pix[0] >> 3
-                    G = pix[1] >> 2
-                    B = pix[2] >> 3
-                    x = (i % width)
-                    y = i//width
-                    i +=1
-                    rgb = (R << 11) | (G << 5) | B
-                    html_string += rgb565_svg(x,y,R,G,B)
-                    data[pos] = rgb >> 8
-                    pos += 1
-                    data[pos] = rgb & 255
-                    pos += 1
-                html_string += SVG_END
-            html_string += f"</DIV>"
-        
-            rhs = [HexInt(x) for x in data]
-
-            prog_arr = cg.progmem_array(conf[CONF_RAW_DATA_ID], rhs)
-
-            cg.new_Pvariable(
-                conf[CONF_ID],
-                prog_arr,
-                width,
-                height,
-                frames,
-                espImage.IMAGE_TYPE["RGB565"],
-                str(conf[CONF_ID]),
-                conf[CONF_PINGPONG],
-                duration,
-            )
-
-            cg.add(var.add_icon(RawExpression(str(conf[CONF_ID]))))
-
-    html_string += "</BODY></HTML>"
-    
+                durations.append(conf[CONF_FRAMEDURATION])
+            frame = image.convert("RGB")
+            if CONF_RESIZE in conf:
+                frame = frame.resize([width, height])
+            pixels = rgb565_frame(frame)
+            data[pos:pos + len(pixels)] = pixels
+            pos += len(pixels)
+
+        return {"width": width, "height": height, "frames": frames, "durations": durations, "data": bytes(data)}
+
+    def icon_svg(icon):
+        width = icon["width"]
+        data = icon["data"]
+        svg = []
+        pos = 0
+        for frameIndex in range(icon["frames"]):
+            svg.append(SVG_ICONSTART if width == 8 else SVG_FULL_SCREEN_START)
+            for i in range(width * icon["height"]):
+                rgb = (data[pos] << 8) | data[pos + 1]
+                pos += 2
+                svg.append(rgb565_svg(i % width, i // width, rgb >> 11, (rgb >> 5) & 0x3F, rgb & 0x1F))
+            svg.append(SVG_END)
+        return "".join(svg)
+
+    var = cg.new_Pvariable(config[CONF_ID])
+
+    logging.info(f"Preparing icons, this may take some seconds.")
+
+    if CONF_ICON_CACHE in config:
+        cache_path = CORE.relative_config_path(config[CONF_ICON_CACHE])
+    else:
+        cache_path = CORE.relative_internal_path("ehmtxv2_icons")
+    cache = IconCache(cache_path, config[CONF_ICON_CACHE_TTL].total_seconds, config[CONF_ICON_OFFLINE], config[CONF_LAMEID_URL])
+
+    def icon_url(conf):
+        if CONF_LAMEID in conf:
+            return cache.lameid_to_url(conf[CONF_LAMEID])
+        return conf.get(CONF_URL)
+
+    try:
+        downloads = cache.fetch_all(url for url in map(icon_url, config[CONF_ICONS]) if url is not None)
+    except IconCacheError as e:
+        raise core.EsphomeError(f" ICONS: {e}")
+    logging.info(f"Icons: {cache.hits} from cache, {cache.downloads} downloaded")
+
+    html = None
     if config[CONF_HTML]:
+        htmlfn = CORE.config_path.replace(".yaml","") + ".html"
         try:
-            htmlfn = CORE.config_path.replace(".yaml","") + ".html"
-            with open(htmlfn, 'w') as f:
-                f.truncate()
-                f.write(html_string)
-                f.close()
-                logging.info(f"EsphoMaTrix: wrote html-file with icon preview: {htmlfn}")
-
-        except:
-            logging.warning(f"EsphoMaTrix: Error writing HTML file: {htmlfn}")    
-    
+            html = open(htmlfn, 'w')
+            html.write(F"<HTML><HEAD><TITLE>{CORE.config_path}</TITLE></HEAD>")
+            html.write('''\
+    <STYLE>
+    svg { padding-top: 2x; padding-right: 2px; padding-bottom: 2px; padding-left: 2px; }
+    </STYLE><BODY>\
+''')
+        except OSError:
+            logging.warning(f"EsphoMaTrix: Error writing HTML file: {htmlfn}")
+            html = None
+
+    yaml_string= ""
+    converted = 0
+
+    for conf in config[CONF_ICONS]:
+
+        if CONF_FILE in conf:
+            path = CORE.relative_config_path(conf[CONF_FILE])
+            try:
+                with open(path, "rb") as f:
+                    source = f.read()
+            except Exception as e:
+                raise core.EsphomeError(f" ICONS: Could not load image file {path}: {e}")
+        elif (CONF_LAMEID in conf) or (CONF_URL in conf):
+            source = downloads[icon_url(conf)]
+        else:
+            source = conf[CONF_RGB565ARRAY].encode()
+
+        key = cache.converted_key(
+            source,
+            resize=conf.get(CONF_RESIZE),
+            frame_duration=conf[CONF_FRAMEDURATION],
+            frame_interval=config[CONF_FRAMEINTERVAL],
+            pingpong=conf[CONF_PINGPONG],
+            maxframes=MAXFRAMES,
+        )
+        icon = cache.load_converted(key)
+        if icon is None:
+            icon = convert_icon(conf, source)
+            if icon is None:
+                logging.warning(f" icon wrong size valid 8x8 or 8x32: {conf[CONF_ID]} skipped!")
+                continue
+            cache.store_converted(key, icon)
+            converted += 1
+
+        width = icon["width"]
+        height = icon["height"]
+        frames = icon["frames"]
+        durations = icon["durations"]
+        duration = durations[0]
+
+        if html is not None:
+            svg = cache.load_html(key)
+            if svg is None:
+                svg = icon_svg(icon)
+                cache.store_html(key, svg)
+            timing = f"{duration}" if len(set(durations)) == 1 else f"{min(durations)}-{max(durations)}"
+            html.write(F"<BR><B>{conf[CONF_ID]}</B>&nbsp;-&nbsp;({timing} ms):<BR>")
+            html.write(f"<DIV ID={conf[CONF_ID]}>{svg}</DIV>")
+        yaml_string += F"\"{conf[CONF_ID]}\","
+
+        rhs = [HexInt(x) for x in icon["data"]]
+
+        prog_arr = cg.progmem_array(conf[CONF_RAW_DATA_ID], rhs)
+
+        if len(set(durations)) > 1:
+            durations_arr = cg.progmem_array(conf[CONF_DURATIONS_ID], durations)
+        else:
+            durations_arr = cg.nullptr
+
+        cg.new_Pvariable(
+            conf[CONF_ID],
+            prog_arr,
+            width,
+            height,
+            frames,
+            espImage.IMAGE_TYPE["RGB565"],
+            str(conf[CONF_ID]),
+            conf[CONF_PINGPONG],
+            duration,
+            durations_arr,
+        )
+
+        cg.add(var.add_icon(RawExpression(str(conf[CONF_ID]))))
+
+    logging.info(f"Icons: {converted} converted, {len(config[CONF_ICONS]) - converted} unchanged")
+
+    if html is not None:
+        html.write("</BODY></HTML>")
+        html.close()
+        logging.info(f"EsphoMaTrix: wrote html-file with icon preview: {htmlfn}")
+
     logging.info("List of icons for e.g. blueprint:\n\n\r["+yaml_string+"]\n")
     
     disp = await cg.get_variable(config[CONF_MATRIXCOMPONENT])
@@ -421,6 +639,9 @@ async def to_code(config):
     if config[CONF_ALWAYS_SHOW_RLINDICATORS]:
         cg.add_define("EHMTXv2_ALWAYS_SHOW_RLINDICATORS")
 
+    if config[CONF_TEXT_MARKUP]:
+        cg.add_define("EHMTXv2_TEXT_MARKUP")
+
     cg.add_define("EHMTXv2_SCROLL_INTERVALL",config[CONF_SCROLLINTERVAL])
     cg.add_define("EHMTXv2_RAINBOW_INTERVALL",config[CONF_RAINBOWINTERVAL])
     cg.add_define("EHMTXv2_FRAME_INTERVALL",config[CONF_FRAMEINTERVAL])
@@ -447,10 +668,49 @@ async def to_code(config):
 
     if config[CONF_RTL]:
         cg.add_define("EHMTXv2_USE_RTL")    
+
+    if config[CONF_MATRIX_WIDTH] != 32:
+        cg.add_define("EHMTXv2_WIDTH",config[CONF_MATRIX_WIDTH])
+
+    if config[CONF_FRAME_CACHE_SIZE] > 0:
+        cg.add_define("EHMTXv2_FRAME_CACHE",config[CONF_FRAME_CACHE_SIZE])
+
+    if config[CONF_TRACE_SIZE] > 0:
+        cg.add_define("EHMTXv2_TRACE_SIZE",config[CONF_TRACE_SIZE])
+
+    if config[CONF_DIAG_SIZE] > 0:
+        cg.add_define("EHMTXv2_DIAG_SIZE",config[CONF_DIAG_SIZE])
+
+    if config[CONF_PERSIST_SIZE] > 0:
+        cg.add_define("EHMTXv2_PERSIST_SIZE",config[CONF_PERSIST_SIZE])
+        cg.add(var.set_persist_interval(config[CONF_PERSIST_INTERVAL]))
+
+    if config[CONF_RENDER_TASK]:
+        cg.add_define("EHMTXv2_RENDER_TASK")
+
+    if config[CONF_COUNT_ALLOCATIONS]:
+        cg.add_define("EHMTXv2_COUNT_ALLOCATIONS")
     
     cg.add(var.set_show_day_of_week(config[CONF_SHOWDOW]))  
     cg.add(var.set_show_date(config[CONF_SHOWDATE]))
     cg.add(var.set_show_seconds(config[CONF_SHOW_SECONDS]))
+
+    # the histograms take about 800 bytes, they are only built in when something reads them
+    stat_keys = {**STAT_TIME_SENSORS, **STAT_FRAME_SENSORS, **STAT_QUEUE_SENSORS, **STAT_CACHE_SENSORS, **STAT_EVENT_SENSORS}
+    if CONF_STATS_INTERVAL in config or any(key in config for key in stat_keys):
+        cg.add_define("EHMTXv2_STATS")
+    if CONF_STATS_INTERVAL in config:
+        cg.add(var.set_stats_interval(config[CONF_STATS_INTERVAL]))
+    for key, index in STAT_TIME_SENSORS.items():
+        if key in config:
+            for offset, stat in enumerate([CONF_P50, CONF_P95, CONF_MAX]):
+                if stat in config[key]:
+                    sens = await sensor.new_sensor(config[key][stat])
+                    cg.add(var.set_stat_sensor(index + offset, sens))
+    for key, index in {**STAT_FRAME_SENSORS, **STAT_QUEUE_SENSORS, **STAT_CACHE_SENSORS, **STAT_EVENT_SENSORS}.items():
+        if key in config:
+            sens = await sensor.new_sensor(config[key])
+            cg.add(var.set_stat_sensor(index, sens))
     
     for conf in config.get(CONF_ON_NEXT_SCREEN, []):
         trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
@@ -476,4 +736,8 @@ async def to_code(config):
         trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
         await automation.build_automation(trigger, [] , conf)
 
+    for conf in config.get(CONF_ON_TIMER_DONE, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
+        await automation.build_automation(trigger, [(cg.std_string, "icon")] , conf)
+
     await cg.register_component(var, config)
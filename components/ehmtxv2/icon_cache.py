@@ -0,0 +1,204 @@
+"""Download cache for the lameid and url icons.
+
+The downloaded bytes are stored once under their sha256 in <cache>/blobs, the
+files in <cache>/refs map the sha256 of a url to its blob and their mtime is
+the download time. <cache>/rgb565 holds the converted icons by source and
+options, see converted_key(). Can be used without esphome to fill the cache in
+advance:
+
+    python3 icon_cache.py --cache DIR 40530 https://example.com/icon.gif
+"""
+
+import argparse
+import base64
+import hashlib
+import json
+import logging
+import os
+import sys
+import tempfile
+import threading
+import time
+from concurrent.futures import ThreadPoolExecutor
+
+import requests
+
+LAMETRIC_URL = "https://developer.lametric.com/content/apps/icon_thumbs/"
+FETCH_TIMEOUT = 4.0
+FETCH_RETRIES = 2
+FETCH_WORKERS = 8
+# bump when the conversion in __init__.py changes its output
+CONVERTER_VERSION = 2
+
+_LOGGER = logging.getLogger(__name__)
+
+
+class IconCacheError(Exception):
+    pass
+
+
+class IconCache:
+    def __init__(self, path, ttl=0, offline=False, lameid_url=LAMETRIC_URL):
+        """ttl in seconds, 0 keeps the downloads forever"""
+        self.path = path
+        self.ttl = ttl
+        self.offline = offline
+        self.lameid_url = lameid_url
+        self.hits = 0
+        self.downloads = 0
+        self._counter_lock = threading.Lock()  # _fetch runs in the fetch_all workers
+
+    def lameid_to_url(self, lameid):
+        return self.lameid_url + str(lameid)
+
+    def _ref_path(self, url):
+        return os.path.join(self.path, "refs", hashlib.sha256(url.encode()).hexdigest())
+
+    def _blob_path(self, digest):
+        return os.path.join(self.path, "blobs", digest)
+
+    @staticmethod
+    def _write(path, content):
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        fd, tmp = tempfile.mkstemp(dir=os.path.dirname(path))
+        with os.fdopen(fd, "wb") as f:
+            f.write(content)
+        os.replace(tmp, path)
+
+    def lookup(self, url, allow_stale=False):
+        """the cached bytes of url or None"""
+        ref = self._ref_path(url)
+        try:
+            with open(ref) as f:
+                digest = f.read().strip()
+            if (self.ttl > 0) and not allow_stale and (time.time() - os.path.getmtime(ref) > self.ttl):
+                return None
+            with open(self._blob_path(digest), "rb") as f:
+                content = f.read()
+        except OSError:
+            return None
+        if hashlib.sha256(content).hexdigest() != digest:
+            return None
+        return content
+
+    def store(self, url, content):
+        digest = hashlib.sha256(content).hexdigest()
+        blob = self._blob_path(digest)
+        if not os.path.exists(blob):
+            self._write(blob, content)
+        self._write(self._ref_path(url), digest.encode())
+
+    @staticmethod
+    def converted_key(source, **options):
+        """hash of the source bytes and everything that changes the converted data"""
+        h = hashlib.sha256(source)
+        h.update(json.dumps({"version": CONVERTER_VERSION, **options}, sort_keys=True, default=str).encode())
+        return h.hexdigest()
+
+    def _converted_path(self, key, ext):
+        return os.path.join(self.path, "rgb565", key + ext)
+
+    def load_converted(self, key):
+        """dict with width, height, frames, duration and the rgb565 data or None"""
+        try:
+            with open(self._converted_path(key, ".json")) as f:
+                icon = json.load(f)
+            icon["data"] = base64.b64decode(icon["data"])
+            return icon
+        except (OSError, ValueError, KeyError):
+            return None
+
+    def store_converted(self, key, icon):
+        try:
+            self._write(
+                self._converted_path(key, ".json"),
+                json.dumps({**icon, "data": base64.b64encode(icon["data"]).decode()}).encode(),
+            )
+        except OSError as e:
+            _LOGGER.warning(f"Could not write to the icon cache: {e}")
+
+    def load_html(self, key):
+        try:
+            with open(self._converted_path(key, ".html")) as f:
+                return f.read()
+        except OSError:
+            return None
+
+    def store_html(self, key, html):
+        try:
+            self._write(self._converted_path(key, ".html"), html.encode())
+        except OSError as e:
+            _LOGGER.warning(f"Could not write to the icon cache: {e}")
+
+    def _download(self, url):
+        error = None
+        for _ in range(FETCH_RETRIES + 1):
+            try:
+                r = requests.get(url, timeout=FETCH_TIMEOUT)
+                if r.status_code == requests.codes.ok:
+                    return r.content
+                error = f"HTTP {r.status_code}"
+                if r.status_code < 500:
+                    break
+            except requests.RequestException as e:
+                error = str(e)
+        raise IconCacheError(f"Could not download {url}: {error}")
+
+    def _fetch(self, url):
+        content = self.lookup(url)
+        if content is not None:
+            with self._counter_lock:
+                self.hits += 1
+            return content
+        stale = self.lookup(url, allow_stale=True)
+        if self.offline:
+            if stale is not None:
+                return stale
+            raise IconCacheError(f"{url} is not in the icon cache {self.path} and offline is set")
+        try:
+            content = self._download(url)
+        except IconCacheError as e:
+            if stale is None:
+                raise
+            _LOGGER.warning(f"{e}, using the cached copy")
+            return stale
+        with self._counter_lock:
+            self.downloads += 1
+        self.store(url, content)
+        return content
+
+    def fetch_all(self, urls):
+        """dict url -> bytes, the misses are downloaded in parallel"""
+        urls = list(dict.fromkeys(urls))
+        if not urls:
+            return {}
+        with ThreadPoolExecutor(max_workers=min(FETCH_WORKERS, len(urls))) as pool:
+            return dict(zip(urls, pool.map(self._fetch, urls)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="fill the ehmtxv2 icon cache")
+    parser.add_argument("--cache", required=True, help="cache directory")
+    parser.add_argument("--ttl", type=int, default=0, help="seconds until a download is refreshed, 0 = never")
+    parser.add_argument("--offline", action="store_true", help="only use the cache")
+    parser.add_argument("--lameid-url", default=LAMETRIC_URL, help="prefix for lameids")
+    parser.add_argument("icons", nargs="+", help="lameids or urls")
+    args = parser.parse_args()
+    logging.basicConfig(format="%(message)s")
+
+    cache = IconCache(args.cache, args.ttl, args.offline, args.lameid_url)
+    urls = [icon if "://" in icon else cache.lameid_to_url(icon) for icon in args.icons]
+    start = time.monotonic()
+    try:
+        result = cache.fetch_all(urls)
+    except IconCacheError as e:
+        print(e, file=sys.stderr)
+        return 1
+    for url, content in result.items():
+        print(f"{len(content):8d} {hashlib.sha256(content).hexdigest()[:12]} {url}")
+    print(f"{cache.hits} cached, {cache.downloads} downloaded in {time.monotonic() - start:.2f} s", file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
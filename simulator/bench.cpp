@@ -0,0 +1,445 @@
+#include "esphome.h"
+#include "sim_harness.h"
+
+#include <chrono>
+#include <getopt.h>
+#include <new>
+
+using namespace esphome;
+
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+#ifdef EHMTXv2_COUNT_ALLOCATIONS
+// the component replaces operator new itself
+#define allocations EHMTX_allocations
+#else
+// every operator new in the process goes through here, allocs/op is the difference around a batch
+static uint64_t allocations = 0;
+
+void *operator new(size_t size)
+{
+  allocations++;
+  void *p = malloc(size == 0 ? 1 : size);
+  if (p == nullptr)
+    throw std::bad_alloc();
+  return p;
+}
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+#endif
+
+struct Result
+{
+  std::string name;
+  uint64_t iterations;
+  double ns_per_op;
+  double allocs_per_op;
+};
+
+static std::vector<Result> results;
+static const char *filter = nullptr;
+static uint32_t min_ms = 200;
+
+// doubles the batch until it runs for at least min_ms, the last batch is reported
+static void bench(const std::string &name, const std::function<void()> &setup, const std::function<void(uint64_t)> &op)
+{
+  if ((filter != nullptr) && (name.find(filter) == std::string::npos))
+    return;
+
+  setup();
+  for (uint64_t i = 0; i < 16; i++)
+    op(i);
+
+  uint64_t n = 16;
+  while (true)
+  {
+    uint64_t alloc_start = allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < n; i++)
+      op(i);
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    if ((ns >= (int64_t)min_ms * 1000000) || (n >= (1ULL << 32)))
+    {
+      results.push_back({name, n, (double)ns / n, (double)(allocations - alloc_start) / n});
+      return;
+    }
+    n *= 2;
+  }
+}
+
+static const std::string SHORT_TEXT = "23°C";
+static const std::string LONG_TEXT =
+    "Die Waschmaschine ist fertig, bitte ausräumen. Außentemperatur 12°C, Luftfeuchte 78%, "
+    "Strompreis 0,31 € pro kWh, nächster Termin: Zahnarzt um 14:30 Uhr. Müll: Gelber Sack am Dienstag.";
+static const std::string MARKUP_TEXT = "23°C [icon:sun] [#ff0000]45%[/] Luftfeuchte [icon:icon2] 0,31 €";
+
+static std::string bitmap_json(int count)
+{
+  std::string json = "[";
+  for (int i = 0; i < count; i++)
+  {
+    if (i > 0)
+      json += ",";
+    json += std::to_string((i * 2731) & 0xFFFF);
+  }
+  return json + "]";
+}
+
+static void clear_queue(EHMTX *ehmtx)
+{
+  for (uint8_t i = 0; i < MAXQUEUE; i++)
+  {
+    ehmtx->queue[i]->mode = MODE_EMPTY;
+    ehmtx->queue[i]->endtime = 0;
+    ehmtx->queue[i]->last_time = 0;
+  }
+}
+
+static EHMTX_queue *shown = nullptr;
+
+// the queue holds only the screen added by add, a forced screen switch selects it
+static void show_only(EHMTX *ehmtx, const std::function<void()> &add)
+{
+  clear_queue(ehmtx);
+  add();
+  ehmtx->next_action_time = 0;
+  ehmtx->tick();
+  ehmtx->next_action_time = ehmtx->uptime() + 1000000;
+  for (uint8_t i = 0; i < MAXQUEUE; i++)
+  {
+    if (ehmtx->queue[i]->mode != MODE_EMPTY)
+    {
+      shown = ehmtx->queue[i];
+    }
+  }
+}
+
+static void fill_queue(EHMTX *ehmtx)
+{
+  clear_queue(ehmtx);
+  for (int i = 0; i < MAXQUEUE; i++)
+  {
+    ehmtx->icon_screen("icon" + std::to_string(i + 2), "Screen " + std::to_string(i), 24 * 60, 10);
+    ehmtx->queue[i]->last_time = ehmtx->uptime() - 100 + i;
+  }
+}
+
+// a full graph next to the sun icon
+static void fill_graph(EHMTX *ehmtx, bool line)
+{
+  ehmtx->graph_screen("sun", 60, 10, line);
+  for (int i = 0; i < MATRIX_WIDTH; i++)
+  {
+    ehmtx->graph_append("sun", 20.0f + 5.0f * sinf(i * 0.4f));
+  }
+}
+
+static void draw_benchmarks(sim::Harness &h)
+{
+  EHMTX *ehmtx = h.ehmtx;
+  auto draw = [ehmtx](uint64_t i)
+  {
+    ehmtx->scroll_step = i % (shown->scroll_reset + 1);
+    shown->draw();
+  };
+
+  struct
+  {
+    const char *name;
+    std::function<void()> add;
+  } modes[] = {
+      {"blank", [ehmtx]()
+       { ehmtx->blank_screen(60, 10); }},
+      {"clock", [ehmtx]()
+       { ehmtx->clock_screen(60, 10); }},
+      {"date", [ehmtx]()
+       { ehmtx->date_screen(60, 10); }},
+      {"full_screen", [ehmtx]()
+       { ehmtx->full_screen("wide", 60, 10); }},
+      {"icon_screen/short", [ehmtx]()
+       { ehmtx->icon_screen("sun", SHORT_TEXT, 60, 10); }},
+      {"icon_screen/long", [ehmtx]()
+       { ehmtx->icon_screen("sun", LONG_TEXT, 60, 10); }},
+      {"text_screen/short", [ehmtx]()
+       { ehmtx->text_screen(SHORT_TEXT, 60, 10); }},
+      {"text_screen/long", [ehmtx]()
+       { ehmtx->text_screen(LONG_TEXT, 60, 10); }},
+      {"text_screen/markup", [ehmtx]()
+       { ehmtx->text_screen(MARKUP_TEXT, 60, 10); }},
+      {"rainbow_icon", [ehmtx]()
+       { ehmtx->rainbow_icon_screen("sun", LONG_TEXT, 60, 10); }},
+      {"rainbow_text", [ehmtx]()
+       { ehmtx->rainbow_text_screen(LONG_TEXT, 60, 10); }},
+      {"rainbow_clock", [ehmtx]()
+       { ehmtx->rainbow_clock_screen(60, 10); }},
+      {"rainbow_date", [ehmtx]()
+       { ehmtx->rainbow_date_screen(60, 10); }},
+      {"graph/bar", [ehmtx]()
+       { fill_graph(ehmtx, false); }},
+      {"graph/line", [ehmtx]()
+       { fill_graph(ehmtx, true); }},
+      {"bitmap_screen", [ehmtx]()
+       { ehmtx->bitmap_screen(bitmap_json(256), 60, 10); }},
+      {"bitmap_small", [ehmtx]()
+       { ehmtx->bitmap_small(bitmap_json(64), LONG_TEXT, 60, 10); }},
+  };
+
+  for (auto &mode : modes)
+  {
+    bench(std::string("queue_draw/") + mode.name, [ehmtx, &mode]()
+          { show_only(ehmtx, mode.add); },
+          draw);
+  }
+
+  // one scroll step per frame, the ticker is refilled before it runs empty
+  bench("queue_draw/ticker", [ehmtx]()
+        { show_only(ehmtx, [ehmtx]() { ehmtx->ticker_screen(LONG_TEXT, 60, 10); }); },
+        [ehmtx](uint64_t i)
+        {
+          sim::now_us += EHMTXv2_SCROLL_INTERVALL * 1000;
+          if (ehmtx->ticker.size() < 2)
+          {
+            ehmtx->ticker_append(LONG_TEXT);
+          }
+          shown->draw(); });
+
+  // a tenth of a second per frame, only the last digit is looked up again most of the time
+  bench("queue_draw/timer", [ehmtx]()
+        { show_only(ehmtx, [ehmtx]() { ehmtx->timer_screen("sun", 3000, 60, 10); }); },
+        [ehmtx](uint64_t i)
+        {
+          sim::now_us += 100000;
+          if (!shown->timer_up && ((int32_t)(millis() - shown->timer_ms) >= 0))
+          {
+            shown->timer_ms = millis() + 3000000;
+          }
+          shown->draw(); });
+
+  bench("ehmtx_draw/icon_screen+indicators", [ehmtx]()
+        {
+          show_only(ehmtx, [ehmtx]() { ehmtx->icon_screen("sun", LONG_TEXT, 60, 10); });
+          ehmtx->show_gauge(60, 0, 200, 0);
+          ehmtx->show_alarm();
+          ehmtx->show_rindicator(0, 0, 255, 2);
+          ehmtx->show_lindicator(0, 255, 0, 2); },
+        [ehmtx](uint64_t i)
+        { ehmtx->draw(); });
+  ehmtx->hide_gauge();
+  ehmtx->hide_alarm();
+  ehmtx->hide_rindicator();
+  ehmtx->hide_lindicator();
+
+  // the last icon is never in the frame cache
+  bench("draw_icon/flash", []() {},
+        [ehmtx](uint64_t i)
+        { ehmtx->draw_icon(0, 0, ehmtx->icon_count - 1); });
+#ifdef EHMTXv2_FRAME_CACHE
+  bench("draw_icon/frame_cache", [ehmtx]()
+        { ehmtx->frame_cache.fill(0, 0, ehmtx->icons[0]); },
+        [ehmtx](uint64_t i)
+        { ehmtx->draw_icon(0, 0, 0); });
+#endif
+}
+
+static void tick_benchmarks(sim::Harness &h)
+{
+  EHMTX *ehmtx = h.ehmtx;
+
+  // the virtual clock advances one display frame per tick, loop() dispatches the queued triggers
+  bench("tick/no_switch", [ehmtx]()
+        {
+          fill_queue(ehmtx);
+          ehmtx->next_action_time = 0;
+          ehmtx->tick();
+          ehmtx->next_action_time = ehmtx->uptime() + 1000000; },
+        [ehmtx](uint64_t i)
+        {
+          sim::now_us += 16000;
+          ehmtx->tick(); });
+
+  bench("tick/switch", [ehmtx]()
+        { fill_queue(ehmtx); },
+        [ehmtx](uint64_t i)
+        {
+          sim::now_us += 16000;
+          ehmtx->next_action_time = 0;
+          ehmtx->tick();
+          ehmtx->loop(); });
+}
+
+static void queue_benchmarks(sim::Harness &h)
+{
+  EHMTX *ehmtx = h.ehmtx;
+  EHMTX_queue *screen = ehmtx->queue[0];
+
+  bench("prepare/short", [screen]()
+        {
+          screen->mode = MODE_TEXT_SCREEN;
+          screen->text = SHORT_TEXT; },
+        [screen](uint64_t i)
+        { screen->prepare(10); });
+  bench("prepare/long", [screen]()
+        {
+          screen->mode = MODE_TEXT_SCREEN;
+          screen->text = LONG_TEXT; },
+        [screen](uint64_t i)
+        { screen->prepare(10); });
+  bench("prepare/markup", [screen]()
+        {
+          screen->mode = MODE_TEXT_SCREEN;
+          screen->text = MARKUP_TEXT; },
+        [screen](uint64_t i)
+        { screen->prepare(10); });
+
+  std::string json = bitmap_json(256);
+  bench("bitmap_screen/256", [ehmtx]()
+        { fill_queue(ehmtx); },
+        [ehmtx, &json](uint64_t i)
+        { ehmtx->bitmap_screen(json, 60, 10); });
+
+  // an update of a screen that is already queued, the argument strings are built outside like the API does
+  std::string text = LONG_TEXT, name = "icon" + std::to_string(MAXICONS - 1);
+  bench("icon_screen/update", [ehmtx, &text, &name]()
+        {
+          fill_queue(ehmtx);
+          ehmtx->icon_screen(name, text); },
+        [ehmtx, &text, &name](uint64_t i)
+        {
+          uint64_t before = allocations;
+          std::string t = text, n = name;
+          allocations = before;
+          ehmtx->icon_screen(std::move(n), std::move(t));
+          ehmtx->loop(); });
+
+  // once the ring is full every append drops the oldest text and reuses its glyph vector
+  bench("ticker_append", [ehmtx]()
+        {
+          clear_queue(ehmtx);
+          ehmtx->ticker_screen(LONG_TEXT, 60, 10); },
+        [ehmtx, &text](uint64_t i)
+        {
+          uint64_t before = allocations;
+          std::string t = text;
+          allocations = before;
+          ehmtx->ticker_append(std::move(t)); });
+
+  // within the range only the new column is computed, a new extreme or a dropped one computes all
+  bench("graph_append/in_range", [ehmtx]()
+        {
+          clear_queue(ehmtx);
+          fill_graph(ehmtx, true); },
+        [ehmtx](uint64_t i)
+        { ehmtx->graph_append("sun", 20.0f + (i % 5)); });
+  bench("graph_append/new_range", [ehmtx]()
+        {
+          clear_queue(ehmtx);
+          fill_graph(ehmtx, true); },
+        [ehmtx](uint64_t i)
+        { ehmtx->graph_append("sun", (float)i); });
+
+  std::string last = "icon" + std::to_string(MAXICONS - 1);
+  bench("find_icon/first", []() {},
+        [ehmtx](uint64_t i)
+        { ehmtx->find_icon("sun"); });
+  bench("find_icon/last", []() {},
+        [ehmtx, &last](uint64_t i)
+        { ehmtx->find_icon(last); });
+  bench("find_icon/missing", []() {},
+        [ehmtx](uint64_t i)
+        { ehmtx->find_icon("nonexistent"); });
+
+  bench("remove_expired_queue_element/none", [ehmtx]()
+        { fill_queue(ehmtx); },
+        [ehmtx](uint64_t i)
+        { ehmtx->remove_expired_queue_element(); });
+  bench("remove_expired_queue_element/one", [ehmtx]()
+        { fill_queue(ehmtx); },
+        [ehmtx](uint64_t i)
+        {
+          EHMTX_queue *slot = ehmtx->queue[i % MAXQUEUE];
+          slot->mode = MODE_ICON_SCREEN;
+          slot->endtime = 1;
+          ehmtx->remove_expired_queue_element(); });
+
+  bench("find_oldest_queue_element", [ehmtx]()
+        { fill_queue(ehmtx); },
+        [ehmtx](uint64_t i)
+        { ehmtx->find_oldest_queue_element(); });
+}
+
+static void usage()
+{
+  fprintf(stderr,
+          "usage: ehmtx-bench [options]\n"
+          "  -f, --filter TEXT   only run benchmarks with TEXT in the name\n"
+          "  -t, --time MS       minimum time per benchmark (default 200)\n"
+          "  -j, --json          print a json array instead of tab separated lines\n");
+}
+
+int main(int argc, char **argv)
+{
+  bool json = false;
+
+  static const struct option LONG_OPTIONS[] = {
+      {"filter", required_argument, nullptr, 'f'}, {"time", required_argument, nullptr, 't'},
+      {"json", no_argument, nullptr, 'j'},         {"help", no_argument, nullptr, 'h'},
+      {nullptr, 0, nullptr, 0}};
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "f:t:jh", LONG_OPTIONS, nullptr)) != -1)
+  {
+    switch (opt)
+    {
+    case 'f':
+      filter = optarg;
+      break;
+    case 't':
+      min_ms = std::max(1, atoi(optarg));
+      break;
+    case 'j':
+      json = true;
+      break;
+    default:
+      usage();
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+
+  sim::log_level = 0;
+  sim::Harness h;
+  sim::add_icons(h.ehmtx, MAXICONS);
+  h.setup();
+  new EHMTXNextScreenTrigger(h.ehmtx);
+  new EHMTXAddScreenTrigger(h.ehmtx);
+  new EHMTXExpiredScreenTrigger(h.ehmtx);
+  h.run_for(2000);
+
+  draw_benchmarks(h);
+  tick_benchmarks(h);
+  queue_benchmarks(h);
+
+  if (json)
+  {
+    printf("[\n");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+      const Result &r = results[i];
+      printf("  {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.1f, \"allocs_per_op\": %.2f}%s\n",
+             r.name.c_str(), (unsigned long long)r.iterations, r.ns_per_op, r.allocs_per_op,
+             i + 1 < results.size() ? "," : "");
+    }
+    printf("]\n");
+  }
+  else
+  {
+    printf("name\tns_per_op\tallocs_per_op\titerations\n");
+    for (const Result &r : results)
+    {
+      printf("%s\t%.1f\t%.2f\t%llu\n", r.name.c_str(), r.ns_per_op, r.allocs_per_op, (unsigned long long)r.iterations);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,24 @@
+#!/usr/bin/env python3
+"""compare two `ehmtx-bench --json` outputs: bench_compare.py old.json new.json"""
+
+import json
+import sys
+
+if len(sys.argv) != 3:
+    print(__doc__.strip())
+    sys.exit(1)
+
+with open(sys.argv[1], encoding="utf-8") as f:
+    old = {r["name"]: r for r in json.load(f)}
+with open(sys.argv[2], encoding="utf-8") as f:
+    new = json.load(f)
+
+print(f"{'name':<40} {'old ns':>10} {'new ns':>10} {'change':>8} {'allocs':>13}")
+for r in new:
+    o = old.get(r["name"])
+    if o is None:
+        print(f"{r['name']:<40} {'-':>10} {r['ns_per_op']:>10.1f} {'new':>8} {r['allocs_per_op']:>13.2f}")
+        continue
+    change = (r["ns_per_op"] - o["ns_per_op"]) / o["ns_per_op"] * 100 if o["ns_per_op"] else 0
+    allocs = f"{o['allocs_per_op']:.2f}->{r['allocs_per_op']:.2f}"
+    print(f"{r['name']:<40} {o['ns_per_op']:>10.1f} {r['ns_per_op']:>10.1f} {change:>+7.1f}% {allocs:>13}")
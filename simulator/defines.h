@@ -0,0 +1,62 @@
+#pragma once
+// values normally emitted by the ehmtxv2 codegen into esphome/core/defines.h
+#define USE_SENSOR
+#ifndef EHMTXv2_SCROLL_INTERVALL
+#define EHMTXv2_SCROLL_INTERVALL 80
+#endif
+#ifndef EHMTXv2_RAINBOW_INTERVALL
+#define EHMTXv2_RAINBOW_INTERVALL 32
+#endif
+#ifndef EHMTXv2_FRAME_INTERVALL
+#define EHMTXv2_FRAME_INTERVALL 192
+#endif
+#ifndef EHMTXv2_CLOCK_INTERVALL
+#define EHMTXv2_CLOCK_INTERVALL 0
+#endif
+#ifndef EHMTXv2_SCROLL_COUNT
+#define EHMTXv2_SCROLL_COUNT 2
+#endif
+#ifndef EHMTXv2_WEEK_START
+#define EHMTXv2_WEEK_START true
+#endif
+#ifndef EHMTXv2_DEFAULT_FONT_OFFSET_X
+#define EHMTXv2_DEFAULT_FONT_OFFSET_X 1
+#endif
+#ifndef EHMTXv2_DEFAULT_FONT_OFFSET_Y
+#define EHMTXv2_DEFAULT_FONT_OFFSET_Y 6
+#endif
+#ifndef EHMTXv2_SPECIAL_FONT_OFFSET_X
+#define EHMTXv2_SPECIAL_FONT_OFFSET_X 1
+#endif
+#ifndef EHMTXv2_SPECIAL_FONT_OFFSET_Y
+#define EHMTXv2_SPECIAL_FONT_OFFSET_Y 6
+#endif
+#ifndef EHMTXv2_DEFAULT_CLOCK_FONT
+#define EHMTXv2_DEFAULT_CLOCK_FONT true
+#endif
+#ifndef EHMTXv2_DATE_FORMAT
+#define EHMTXv2_DATE_FORMAT "%d.%m."
+#endif
+#ifndef EHMTXv2_TIME_FORMAT
+#define EHMTXv2_TIME_FORMAT "%H:%M"
+#endif
+#ifndef EHMTXv2_PERSIST_SIZE
+#define EHMTXv2_PERSIST_SIZE 1024
+#elif EHMTXv2_PERSIST_SIZE == 0
+#undef EHMTXv2_PERSIST_SIZE
+#endif
+#ifndef EHMTXv2_DIAG_SIZE
+#define EHMTXv2_DIAG_SIZE 64
+#elif EHMTXv2_DIAG_SIZE == 0
+#undef EHMTXv2_DIAG_SIZE
+#endif
+#ifndef EHMTXv2_STATS
+#define EHMTXv2_STATS 1
+#elif EHMTXv2_STATS == 0
+#undef EHMTXv2_STATS
+#endif
+#ifndef EHMTXv2_TEXT_MARKUP
+#define EHMTXv2_TEXT_MARKUP 1
+#elif EHMTXv2_TEXT_MARKUP == 0
+#undef EHMTXv2_TEXT_MARKUP
+#endif
@@ -0,0 +1,5 @@
+#pragma once
+// host replacement for the esphome.h aggregate header generated by esphome
+#include "sim_esphome.h"
+#include "defines.h"
+#include "EHMTX.h"
@@ -0,0 +1,13 @@
+#pragma once
+// host stand-in for the FreeRTOS types used by the render task, see sim_freertos.cpp
+#include <cstdint>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdPASS 1
+#define pdFAIL 0
+#define portNUM_PROCESSORS 2
+#define tskNO_AFFINITY 0x7FFFFFFF
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms)) // 1 kHz tick like the esp32 arduino core
@@ -0,0 +1,22 @@
+#pragma once
+#include "FreeRTOS.h"
+
+struct sim_task;
+typedef sim_task *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char *name, uint32_t stack_depth, void *parameters,
+                                   UBaseType_t priority, TaskHandle_t *created_task, BaseType_t core_id);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+TickType_t xTaskGetTickCount();
+void vTaskDelayUntil(TickType_t *previous_wake_time, TickType_t time_increment);
+BaseType_t xPortGetCoreID();
+
+namespace esphome
+{
+  namespace sim
+  {
+    // runs every task until its next vTaskDelayUntil(), the harness calls it once per frame
+    void step_tasks();
+  }
+}
@@ -0,0 +1,183 @@
+#include "esphome.h"
+#include "sim_harness.h"
+
+#include <getopt.h>
+
+using namespace esphome;
+
+static void usage()
+{
+  fprintf(stderr,
+          "usage: ehmtx-sim [options]\n"
+          "  -s, --seconds N     virtual seconds to run (default 60)\n"
+          "  -a, --ansi          print frames to the terminal\n"
+          "  -p, --ppm DIR       write frames as DIR/frame_NNNNNN.ppm\n"
+          "  -e, --every N       only dump every Nth frame (default 1)\n"
+          "  -z, --scale N       pixel size in the ppm files (default 10)\n"
+          "  -u, --unsynced N    keep the clock invalid for the first N seconds\n"
+          "  -l, --log LEVEL     0 none, 1 error ... 5 verbose (default 2)\n"
+          "  -t, --trace         dump the service trace at the end, needs DEFINES=-DEHMTXv2_TRACE_SIZE=N\n"
+          "  -d, --diag          dump the diag ring at the end\n"
+          "  -f, --prefs FILE    restore the queue from FILE and store it there at the end, like a reboot\n"
+          "  -n, --no-screens    don't add the sample screens\n");
+}
+
+// the sample screens from tests/ehtmxv2-template.yaml
+static void add_demo_screens(EHMTX *ehmtx)
+{
+  ehmtx->icon_screen("sun", "Hallo 23°C", 5, 6);
+  ehmtx->text_screen("Ein langer Text mit Umlauten ÄÖÜ und € zum Scrollen", 5, 6);
+  ehmtx->full_screen("wide", 5, 4);
+  ehmtx->rainbow_icon_screen("icon2", "Regenbogen", 5, 4);
+  ehmtx->show_gauge(60, 0, 200, 0);
+  ehmtx->show_alarm();
+  ehmtx->show_rindicator(0, 0, 255, 2);
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t seconds = 60;
+  uint32_t every = 1;
+  uint32_t unsynced = 0;
+  int scale = 10;
+  bool ansi = false;
+  bool trace = false;
+  bool diag = false;
+  bool screens = true;
+  const char *prefs = nullptr;
+  const char *ppm_dir = nullptr;
+
+  static const struct option LONG_OPTIONS[] = {
+      {"seconds", required_argument, nullptr, 's'}, {"ansi", no_argument, nullptr, 'a'},
+      {"ppm", required_argument, nullptr, 'p'},     {"every", required_argument, nullptr, 'e'},
+      {"scale", required_argument, nullptr, 'z'},   {"unsynced", required_argument, nullptr, 'u'},
+      {"log", required_argument, nullptr, 'l'},     {"trace", no_argument, nullptr, 't'},
+      {"diag", no_argument, nullptr, 'd'},          {"prefs", required_argument, nullptr, 'f'},
+      {"no-screens", no_argument, nullptr, 'n'},    {"help", no_argument, nullptr, 'h'},
+      {nullptr, 0, nullptr, 0}};
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "s:ap:e:z:u:l:tdf:nh", LONG_OPTIONS, nullptr)) != -1)
+  {
+    switch (opt)
+    {
+    case 's':
+      seconds = atoi(optarg);
+      break;
+    case 'a':
+      ansi = true;
+      break;
+    case 'p':
+      ppm_dir = optarg;
+      break;
+    case 'e':
+      every = std::max(1, atoi(optarg));
+      break;
+    case 'z':
+      scale = std::max(1, atoi(optarg));
+      break;
+    case 'u':
+      unsynced = atoi(optarg);
+      break;
+    case 'l':
+      sim::log_level = atoi(optarg);
+      break;
+    case 't':
+      trace = true;
+      break;
+    case 'd':
+      diag = true;
+      break;
+    case 'f':
+      prefs = optarg;
+      break;
+    case 'n':
+      screens = false;
+      break;
+    default:
+      usage();
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+
+  if (prefs != nullptr)
+  {
+    sim::load_preferences(prefs);
+  }
+
+  sim::Harness h;
+  sim::add_icons(h.ehmtx, 8);
+  h.clock->synced = (unsynced == 0);
+  h.setup();
+
+  auto *next_screen = new EHMTXNextScreenTrigger(h.ehmtx);
+  next_screen->add_callback([](std::string icon, std::string text)
+                            { fprintf(stderr, "[%8.3f] next screen: icon: \"%s\" text: \"%s\"\n", sim::now_us / 1e6,
+                                      icon.c_str(), text.c_str()); });
+
+  auto on_frame = [&]()
+  {
+    if ((h.frames % every) != 0)
+      return;
+    if (ansi)
+    {
+      printf("frame %llu t=%.3f s\n", (unsigned long long)h.frames, sim::now_us / 1e6);
+      sim::dump_ansi(stdout, h.display);
+    }
+    if (ppm_dir != nullptr)
+    {
+      char path[512];
+      snprintf(path, sizeof(path), "%s/frame_%06llu.ppm", ppm_dir, (unsigned long long)h.frames);
+      if (!sim::write_ppm(path, h.display, scale))
+      {
+        fprintf(stderr, "can't write %s\n", path);
+        exit(1);
+      }
+    }
+  };
+
+  h.run_for(1000, on_frame);
+  if (screens)
+  {
+    add_demo_screens(h.ehmtx);
+  }
+  // the screens are shown before the time sync, the clock and date wait for it
+  if (unsynced > 0)
+  {
+    h.run_for(unsynced * 1000, on_frame);
+    h.clock->synced = true;
+  }
+  h.run_for(seconds * 1000, on_frame);
+
+  if (prefs != nullptr)
+  {
+    h.ehmtx->on_safe_shutdown();
+    if (!sim::save_preferences(prefs))
+    {
+      fprintf(stderr, "can't write %s\n", prefs);
+    }
+  }
+
+  if (trace)
+  {
+#ifdef EHMTXv2_TRACE_SIZE
+    sim::log_level = std::max(sim::log_level, 3);
+    h.ehmtx->dump_trace();
+#else
+    fprintf(stderr, "build with DEFINES=-DEHMTXv2_TRACE_SIZE=N to record a trace\n");
+#endif
+  }
+
+  if (diag)
+  {
+#ifdef EHMTXv2_DIAG_SIZE
+    sim::log_level = std::max(sim::log_level, 3);
+    h.ehmtx->dump_diag();
+#else
+    fprintf(stderr, "built with DEFINES=-DEHMTXv2_DIAG_SIZE=0, there is no diag ring\n");
+#endif
+  }
+
+  fprintf(stderr, "%llu frames in %u virtual seconds\n", (unsigned long long)h.frames, seconds + unsynced + 1);
+  return 0;
+}
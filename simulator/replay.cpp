@@ -0,0 +1,385 @@
+#include "esphome.h"
+#include "sim_harness.h"
+
+#include <chrono>
+#include <fstream>
+#include <getopt.h>
+#include <iostream>
+
+using namespace esphome;
+
+// one value of a trace record: [millis, timestamp, "service", args...]
+struct Value
+{
+  bool is_string = false;
+  std::string str;
+  int64_t num = 0;
+  double real = 0;
+};
+
+struct Record
+{
+  uint64_t ms;
+  time_t timestamp;
+  std::string service;
+  std::vector<Value> args;
+};
+
+static bool parse_record(const std::string &line, Record &record)
+{
+  std::vector<Value> values;
+  size_t i = line.find('[');
+  if (i == std::string::npos)
+    return false;
+  i++;
+  while (i < line.length())
+  {
+    while ((i < line.length()) && ((line[i] == ' ') || (line[i] == ',')))
+      i++;
+    if ((i >= line.length()) || (line[i] == ']'))
+      break;
+
+    Value v;
+    if (line[i] == '"')
+    {
+      v.is_string = true;
+      for (i++; (i < line.length()) && (line[i] != '"'); i++)
+      {
+        if ((line[i] == '\\') && (i + 1 < line.length()))
+        {
+          i++;
+          v.str += (line[i] == 'n') ? '\n' : line[i];
+        }
+        else
+        {
+          v.str += line[i];
+        }
+      }
+      i++;
+    }
+    else if (line.compare(i, 4, "true") == 0)
+    {
+      v.num = 1;
+      i += 4;
+    }
+    else if (line.compare(i, 5, "false") == 0)
+    {
+      i += 5;
+    }
+    else
+    {
+      char *end;
+      v.num = strtoll(line.c_str() + i, &end, 10);
+      v.real = strtod(line.c_str() + i, &end);
+      if (end == line.c_str() + i)
+        return false;
+      i = end - line.c_str();
+    }
+    values.push_back(v);
+  }
+  if ((values.size() < 3) || !values[2].is_string)
+    return false;
+  record.ms = values[0].num;
+  record.timestamp = values[1].num;
+  record.service = values[2].str;
+  record.args.assign(values.begin() + 3, values.end());
+  return true;
+}
+
+// esphome logs are colored and may have windows line ends
+static std::string strip_line(const std::string &line)
+{
+  std::string out;
+  for (size_t i = 0; i < line.length(); i++)
+  {
+    if (line[i] == '\x1b')
+    {
+      while ((i < line.length()) && (line[i] != 'm'))
+        i++;
+      continue;
+    }
+    out += line[i];
+  }
+  while (!out.empty() && ((out.back() == '\r') || (out.back() == ' ')))
+    out.pop_back();
+  return out;
+}
+
+// accepts the raw records or the esphome log of the dump_trace service ("trace >" and "trace +" lines)
+static std::vector<Record> read_trace(std::istream &in)
+{
+  std::vector<Record> records;
+  std::string line, pending;
+  auto flush = [&]()
+  {
+    Record record;
+    size_t end = pending.rfind(']');
+    if ((end != std::string::npos) && parse_record(pending.substr(0, end + 1), record))
+      records.push_back(record);
+    else if (!pending.empty())
+      fprintf(stderr, "skipping unreadable record: %.60s\n", pending.c_str());
+    pending.clear();
+  };
+
+  while (std::getline(in, line))
+  {
+    line = strip_line(line);
+    size_t start = line.find("trace > ");
+    size_t more = line.find("trace + ");
+    if (start != std::string::npos)
+    {
+      flush();
+      pending = line.substr(start + 8);
+    }
+    else if (more != std::string::npos)
+    {
+      pending += line.substr(more + 8);
+    }
+    else if ((line.length() > 1) && (line[0] == '[') && isdigit(line[1]))
+    {
+      flush();
+      pending = line;
+    }
+  }
+  flush();
+  return records;
+}
+
+class Call
+{
+public:
+  explicit Call(const Record &record) : record_(record) {}
+  std::string s(size_t i) const { return i < this->record_.args.size() ? this->record_.args[i].str : ""; }
+  int i(size_t i, int d = 0) const { return i < this->record_.args.size() ? (int)this->record_.args[i].num : d; }
+  float f(size_t i, float d = 0) const { return i < this->record_.args.size() ? (float)this->record_.args[i].real : d; }
+  bool b(size_t i, bool d = true) const { return i < this->record_.args.size() ? this->record_.args[i].num != 0 : d; }
+
+protected:
+  const Record &record_;
+};
+
+static bool dispatch(EHMTX *e, const Record &record)
+{
+  Call c(record);
+  const std::string &n = record.service;
+  if (n == "icon_screen")
+    e->icon_screen(c.s(0), c.s(1), c.i(2), c.i(3), c.b(4), c.i(5), c.i(6), c.i(7));
+  else if (n == "rainbow_icon_screen")
+    e->rainbow_icon_screen(c.s(0), c.s(1), c.i(2), c.i(3), c.b(4));
+  else if (n == "text_screen")
+    e->text_screen(c.s(0), c.i(1), c.i(2), c.b(3), c.i(4), c.i(5), c.i(6));
+  else if (n == "rainbow_text_screen")
+    e->rainbow_text_screen(c.s(0), c.i(1), c.i(2), c.b(3));
+  else if (n == "ticker_screen")
+    e->ticker_screen(c.s(0), c.i(1), c.i(2), c.b(3), c.i(4), c.i(5), c.i(6));
+  else if (n == "ticker_append")
+    e->ticker_append(c.s(0));
+  else if (n == "graph_screen")
+    e->graph_screen(c.s(0), c.i(1), c.i(2), c.b(3, false), c.i(4), c.i(5), c.i(6));
+  else if (n == "graph_append")
+    e->graph_append(c.s(0), c.f(1));
+  else if (n == "timer_screen")
+    e->timer_screen(c.s(0), c.i(1), c.i(2), c.i(3), c.b(4), c.i(5), c.i(6), c.i(7));
+  else if (n == "timer_until")
+    e->timer_until(c.s(0), c.i(1), c.i(2), c.i(3), c.b(4), c.i(5), c.i(6), c.i(7));
+  else if (n == "full_screen")
+    e->full_screen(c.s(0), c.i(1), c.i(2));
+  else if (n == "clock_screen")
+    e->clock_screen(c.i(0), c.i(1), c.b(2), c.i(3), c.i(4), c.i(5));
+  else if (n == "rainbow_clock_screen")
+    e->rainbow_clock_screen(c.i(0), c.i(1), c.b(2));
+  else if (n == "date_screen")
+    e->date_screen(c.i(0), c.i(1), c.b(2), c.i(3), c.i(4), c.i(5));
+  else if (n == "rainbow_date_screen")
+    e->rainbow_date_screen(c.i(0), c.i(1), c.b(2));
+  else if (n == "blank_screen")
+    e->blank_screen(c.i(0), c.i(1));
+  else if (n == "bitmap_screen")
+    e->bitmap_screen(c.s(0), c.i(1), c.i(2));
+  else if (n == "bitmap_small")
+    e->bitmap_small(c.s(0), c.s(1), c.i(2), c.i(3), c.b(4), c.i(5), c.i(6), c.i(7));
+  else if (n == "del_screen")
+    e->del_screen(c.s(0), c.i(1));
+  else if (n == "force_screen")
+    e->force_screen(c.s(0), c.i(1));
+  else if (n == "skip_screen")
+    e->skip_screen();
+  else if (n == "hold_screen")
+    e->hold_screen(c.i(0));
+  else if (n == "show_gauge")
+    e->show_gauge(c.i(0), c.i(1), c.i(2), c.i(3), c.i(4), c.i(5), c.i(6));
+  else if (n == "color_gauge")
+    e->color_gauge(c.s(0));
+  else if (n == "hide_gauge")
+    e->hide_gauge();
+  else if (n == "show_alarm")
+    e->show_alarm(c.i(0), c.i(1), c.i(2), c.i(3));
+  else if (n == "hide_alarm")
+    e->hide_alarm();
+  else if (n == "show_rindicator")
+    e->show_rindicator(c.i(0), c.i(1), c.i(2), c.i(3));
+  else if (n == "hide_rindicator")
+    e->hide_rindicator();
+  else if (n == "show_lindicator")
+    e->show_lindicator(c.i(0), c.i(1), c.i(2), c.i(3));
+  else if (n == "hide_lindicator")
+    e->hide_lindicator();
+  else if (n == "set_today_color")
+    e->set_today_color(c.i(0), c.i(1), c.i(2));
+  else if (n == "set_weekday_color")
+    e->set_weekday_color(c.i(0), c.i(1), c.i(2));
+  else if (n == "set_clock_color")
+    e->set_clock_color(c.i(0), c.i(1), c.i(2));
+  else if (n == "set_display_on")
+    e->set_display_on();
+  else if (n == "set_display_off")
+    e->set_display_off();
+  else if (n == "set_brightness")
+    e->set_brightness(c.i(0));
+  else
+    return false;
+  return true;
+}
+
+static std::string format_time(time::RealTimeClock *clock)
+{
+  char buffer[32];
+  time_t ts = clock->now().timestamp;
+  struct tm c_tm;
+  gmtime_r(&ts, &c_tm);
+  strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &c_tm);
+  return buffer;
+}
+
+static void usage()
+{
+  fprintf(stderr,
+          "usage: ehmtx-replay [options] TRACE\n"
+          "  TRACE is a file with the output of the dump_trace service or - for stdin\n"
+          "  -f, --frame-ms N    display update_interval in ms (default 16)\n"
+          "  -r, --report S      print the tick+draw costs every S virtual seconds (default 3600)\n"
+          "  -t, --tail S        keep running S seconds after the last call (default 60)\n"
+          "  -q, --quiet         don't print the screen changes\n"
+          "  -l, --log LEVEL     0 none, 1 error ... 5 verbose (default 0)\n");
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t frame_ms = 16;
+  uint32_t report_s = 3600;
+  uint32_t tail_s = 60;
+  bool quiet = false;
+  sim::log_level = 0;
+
+  static const struct option LONG_OPTIONS[] = {
+      {"frame-ms", required_argument, nullptr, 'f'}, {"report", required_argument, nullptr, 'r'},
+      {"tail", required_argument, nullptr, 't'},     {"quiet", no_argument, nullptr, 'q'},
+      {"log", required_argument, nullptr, 'l'},      {"help", no_argument, nullptr, 'h'},
+      {nullptr, 0, nullptr, 0}};
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "f:r:t:ql:h", LONG_OPTIONS, nullptr)) != -1)
+  {
+    switch (opt)
+    {
+    case 'f':
+      frame_ms = std::max(1, atoi(optarg));
+      break;
+    case 'r':
+      report_s = std::max(1, atoi(optarg));
+      break;
+    case 't':
+      tail_s = atoi(optarg);
+      break;
+    case 'q':
+      quiet = true;
+      break;
+    case 'l':
+      sim::log_level = atoi(optarg);
+      break;
+    default:
+      usage();
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc - 1)
+  {
+    usage();
+    return 1;
+  }
+
+  std::vector<Record> records;
+  if (strcmp(argv[optind], "-") == 0)
+  {
+    records = read_trace(std::cin);
+  }
+  else
+  {
+    std::ifstream in(argv[optind]);
+    if (!in)
+    {
+      fprintf(stderr, "can't read %s\n", argv[optind]);
+      return 1;
+    }
+    records = read_trace(in);
+  }
+  if (records.empty())
+  {
+    fprintf(stderr, "no trace records found\n");
+    return 1;
+  }
+
+  sim::Harness h;
+  h.frame_interval_ms = frame_ms;
+  h.display->set_update_interval(frame_ms);
+  sim::add_icons(h.ehmtx, MAXICONS);
+  // the device clock at millis() == 0
+  h.clock->epoch_offset = records[0].timestamp - (time_t)(records[0].ms / 1000);
+  h.setup();
+
+  if (!quiet)
+  {
+    auto *next_screen = new EHMTXNextScreenTrigger(h.ehmtx);
+    next_screen->add_callback([&h](std::string icon, std::string text)
+                              { printf("%s screen icon: \"%s\" text: \"%s\"\n", format_time(h.clock).c_str(), icon.c_str(), text.c_str()); });
+    auto *next_clock = new EHMTXNextClockTrigger(h.ehmtx);
+    next_clock->add_callback([&h]()
+                             { printf("%s clock\n", format_time(h.clock).c_str()); });
+  }
+
+  EHMTX_Histogram window, total;
+  uint64_t next_report_us = (uint64_t)report_s * 1000000;
+  auto on_frame = [&]()
+  {
+    window.add(h.frame_ns);
+    total.add(h.frame_ns);
+    if (sim::now_us >= next_report_us)
+    {
+      printf("%s cost frames: %u tick+draw p50: %u p95: %u max: %u ns\n", format_time(h.clock).c_str(), window.count,
+             window.percentile(50), window.percentile(95), window.max);
+      window.reset();
+      next_report_us += (uint64_t)report_s * 1000000;
+    }
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  uint32_t unknown = 0;
+  for (const Record &record : records)
+  {
+    uint64_t at_us = record.ms * 1000;
+    if (at_us > sim::now_us)
+      h.run_for((at_us - sim::now_us) / 1000, on_frame);
+    if (!dispatch(h.ehmtx, record))
+    {
+      if (unknown++ == 0)
+        fprintf(stderr, "unknown service %s\n", record.service.c_str());
+    }
+  }
+  h.run_for(tail_s * 1000, on_frame);
+  double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  printf("replayed %zu calls (%u unknown), %llu frames, %.0f virtual seconds in %.2f s (%.0fx)\n", records.size(), unknown,
+         (unsigned long long)h.frames, sim::now_us / 1e6, wall, sim::now_us / 1e6 / wall);
+  printf("tick+draw p50: %u p95: %u max: %u ns\n", total.percentile(50), total.percentile(95), total.max);
+  return 0;
+}
@@ -0,0 +1,544 @@
+#include "esphome.h"
+
+namespace esphome
+{
+  namespace sim
+  {
+    uint64_t now_us = 0;
+    int log_level = 2;
+
+    void log(int level, const char *tag, const char *format, ...)
+    {
+      static const char LEVELS[] = "NEWIDV";
+      if (level > log_level)
+        return;
+      va_list args;
+      va_start(args, format);
+      fprintf(stderr, "[%8.3f][%c][%s]: ", now_us / 1e6, LEVELS[level], tag);
+      vfprintf(stderr, format, args);
+      fprintf(stderr, "\n");
+      va_end(args);
+    }
+  }
+
+  ESPPreferences *global_preferences = new ESPPreferences();
+
+  uint32_t fnv1_hash(const std::string &str)
+  {
+    uint32_t hash = 2166136261UL;
+    for (char c : str)
+    {
+      hash *= 16777619UL;
+      hash ^= c;
+    }
+    return hash;
+  }
+
+  namespace sim
+  {
+    // records of type, size and data
+    bool load_preferences(const char *path)
+    {
+      FILE *f = fopen(path, "rb");
+      if (f == nullptr)
+        return false;
+      uint32_t header[2];
+      while (fread(header, sizeof(header), 1, f) == 1)
+      {
+        std::vector<uint8_t> &data = global_preferences->data[header[0]];
+        data.resize(header[1]);
+        if (fread(data.data(), 1, header[1], f) != header[1])
+          break;
+      }
+      fclose(f);
+      return true;
+    }
+
+    bool save_preferences(const char *path)
+    {
+      FILE *f = fopen(path, "wb");
+      if (f == nullptr)
+        return false;
+      for (auto &pref : global_preferences->data)
+      {
+        uint32_t header[2] = {pref.first, (uint32_t)pref.second.size()};
+        fwrite(header, sizeof(header), 1, f);
+        fwrite(pref.second.data(), 1, pref.second.size(), f);
+      }
+      fclose(f);
+      return true;
+    }
+  }
+
+  void hsv_to_rgb(int hue, float saturation, float value, float &red, float &green, float &blue)
+  {
+    float chroma = value * saturation;
+    float hue_prime = fmod(hue / 60.0, 6);
+    float intermediate = chroma * (1 - fabs(fmod(hue_prime, 2) - 1));
+    float delta = value - chroma;
+
+    if (0 <= hue_prime && hue_prime < 1)
+    {
+      red = chroma;
+      green = intermediate;
+      blue = 0;
+    }
+    else if (1 <= hue_prime && hue_prime < 2)
+    {
+      red = intermediate;
+      green = chroma;
+      blue = 0;
+    }
+    else if (2 <= hue_prime && hue_prime < 3)
+    {
+      red = 0;
+      green = chroma;
+      blue = intermediate;
+    }
+    else if (3 <= hue_prime && hue_prime < 4)
+    {
+      red = 0;
+      green = intermediate;
+      blue = chroma;
+    }
+    else if (4 <= hue_prime && hue_prime < 5)
+    {
+      red = intermediate;
+      green = 0;
+      blue = chroma;
+    }
+    else if (5 <= hue_prime && hue_prime < 6)
+    {
+      red = chroma;
+      green = 0;
+      blue = intermediate;
+    }
+    else
+    {
+      red = 0;
+      green = 0;
+      blue = 0;
+    }
+    red += delta;
+    green += delta;
+    blue += delta;
+  }
+
+  size_t ESPTime::strftime(char *buffer, size_t buffer_len, const char *format)
+  {
+    struct tm c_tm = {};
+    c_tm.tm_sec = this->second;
+    c_tm.tm_min = this->minute;
+    c_tm.tm_hour = this->hour;
+    c_tm.tm_mday = this->day_of_month;
+    c_tm.tm_mon = this->month - 1;
+    c_tm.tm_year = this->year - 1900;
+    c_tm.tm_wday = this->day_of_week - 1;
+    c_tm.tm_yday = this->day_of_year - 1;
+    return ::strftime(buffer, buffer_len, format, &c_tm);
+  }
+
+  ESPTime ESPTime::from_epoch_local(time_t epoch)
+  {
+    struct tm c_tm;
+    gmtime_r(&epoch, &c_tm);
+    ESPTime t;
+    t.second = c_tm.tm_sec;
+    t.minute = c_tm.tm_min;
+    t.hour = c_tm.tm_hour;
+    t.day_of_week = c_tm.tm_wday + 1;
+    t.day_of_month = c_tm.tm_mday;
+    t.day_of_year = c_tm.tm_yday + 1;
+    t.month = c_tm.tm_mon + 1;
+    t.year = c_tm.tm_year + 1900;
+    t.is_dst = false;
+    t.timestamp = epoch;
+    return t;
+  }
+
+  namespace time
+  {
+    ESPTime RealTimeClock::now()
+    {
+      if (!this->synced)
+      {
+        ESPTime t = ESPTime::from_epoch_local(millis() / 1000);
+        return t;
+      }
+      return ESPTime::from_epoch_local(this->epoch_offset + (time_t)(sim::now_us / 1000000));
+    }
+  }
+
+  namespace display
+  {
+    const Color COLOR_OFF(0, 0, 0, 0);
+    const Color COLOR_ON(255, 255, 255, 255);
+
+    void DisplayBuffer::draw_pixel_at(int x, int y, Color color)
+    {
+      if (x < 0 || y < 0 || x >= this->get_width_internal() || y >= this->get_height_internal())
+        return;
+      this->draw_absolute_pixel_internal(x, y, color);
+    }
+
+    void DisplayBuffer::line(int x1, int y1, int x2, int y2, Color color)
+    {
+      const int32_t dx = abs(x2 - x1), sx = x1 < x2 ? 1 : -1;
+      const int32_t dy = -abs(y2 - y1), sy = y1 < y2 ? 1 : -1;
+      int32_t err = dx + dy;
+
+      while (true)
+      {
+        this->draw_pixel_at(x1, y1, color);
+        if (x1 == x2 && y1 == y2)
+          break;
+        int32_t e2 = 2 * err;
+        if (e2 >= dy)
+        {
+          err += dy;
+          x1 += sx;
+        }
+        if (e2 <= dx)
+        {
+          err += dx;
+          y1 += sy;
+        }
+      }
+    }
+
+    void DisplayBuffer::horizontal_line(int x, int y, int width, Color color)
+    {
+      for (int i = x; i < x + width; i++)
+        this->draw_pixel_at(i, y, color);
+    }
+
+    void DisplayBuffer::vertical_line(int x, int y, int height, Color color)
+    {
+      for (int i = y; i < y + height; i++)
+        this->draw_pixel_at(x, i, color);
+    }
+
+    void DisplayBuffer::rectangle(int x1, int y1, int width, int height, Color color)
+    {
+      this->horizontal_line(x1, y1, width, color);
+      this->horizontal_line(x1, y1 + height - 1, width, color);
+      this->vertical_line(x1, y1, height, color);
+      this->vertical_line(x1 + width - 1, y1, height, color);
+    }
+
+    void DisplayBuffer::filled_rectangle(int x1, int y1, int width, int height, Color color)
+    {
+      for (int i = y1; i < y1 + height; i++)
+        this->horizontal_line(x1, i, width, color);
+    }
+
+    void DisplayBuffer::get_text_bounds(int x, int y, const char *text, BaseFont *font, TextAlign align, int *x1, int *y1,
+                                        int *width, int *height)
+    {
+      int x_offset, baseline;
+      font->measure(text, width, &x_offset, &baseline, height);
+
+      auto x_align = TextAlign(int(align) & 0x18);
+      auto y_align = TextAlign(int(align) & 0x07);
+
+      switch (x_align)
+      {
+      case TextAlign::RIGHT:
+        *x1 = x - *width;
+        break;
+      case TextAlign::CENTER_HORIZONTAL:
+        *x1 = x - (*width) / 2;
+        break;
+      case TextAlign::LEFT:
+      default:
+        *x1 = x;
+        break;
+      }
+      switch (y_align)
+      {
+      case TextAlign::BOTTOM:
+        *y1 = y - *height;
+        break;
+      case TextAlign::BASELINE:
+        *y1 = y - baseline;
+        break;
+      case TextAlign::CENTER_VERTICAL:
+        *y1 = y - (*height) / 2;
+        break;
+      case TextAlign::TOP:
+      default:
+        *y1 = y;
+        break;
+      }
+    }
+
+    void DisplayBuffer::print(int x, int y, BaseFont *font, Color color, TextAlign align, const char *text)
+    {
+      int x_start, y_start;
+      int width, height;
+      this->get_text_bounds(x, y, text, font, align, &x_start, &y_start, &width, &height);
+      font->print(x_start, y_start, this, color, text);
+    }
+
+    void DisplayBuffer::print(int x, int y, BaseFont *font, Color color, const char *text)
+    {
+      this->print(x, y, font, color, TextAlign::TOP_LEFT, text);
+    }
+
+    void DisplayBuffer::strftime(int x, int y, BaseFont *font, Color color, TextAlign align, const char *format,
+                                 ESPTime time)
+    {
+      char buffer[64];
+      size_t ret = time.strftime(buffer, sizeof(buffer), format);
+      if (ret > 0)
+        this->print(x, y, font, color, align, buffer);
+    }
+
+    void DisplayBuffer::image(int x, int y, BaseImage *image, Color color_on, Color color_off)
+    {
+      image->draw(x, y, this, color_on, color_off);
+    }
+  }
+
+  namespace image
+  {
+    Color Image::get_rgb565_pixel_(int x, int y) const
+    {
+      const uint32_t pos = (x + y * this->width_) * 2;
+      uint16_t rgb565 =
+          progmem_read_byte(this->data_start_ + pos + 0) << 8 | progmem_read_byte(this->data_start_ + pos + 1);
+      auto r = (rgb565 & 0xF800) >> 11;
+      auto g = (rgb565 & 0x07E0) >> 5;
+      auto b = rgb565 & 0x001F;
+      return Color((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+    }
+
+    // the darkest green is the transparent color of RGB565 images with transparency
+    bool Image::is_transparent_(int x, int y) const
+    {
+      const uint32_t pos = (x + y * this->width_) * 2;
+      return this->transparent_ && (progmem_read_byte(this->data_start_ + pos + 0) == 0x00) &&
+             (progmem_read_byte(this->data_start_ + pos + 1) == 0x20);
+    }
+
+    Color Image::get_pixel(int x, int y, Color color_on, Color color_off) const
+    {
+      if (x < 0 || x >= this->width_ || y < 0 || y >= this->height_)
+        return color_off;
+      return this->get_rgb565_pixel_(x, y);
+    }
+
+    void Image::draw(int x, int y, display::DisplayBuffer *display, Color color_on, Color color_off)
+    {
+      for (int img_x = 0; img_x < this->width_; img_x++)
+      {
+        for (int img_y = 0; img_y < this->height_; img_y++)
+        {
+          if (!this->is_transparent_(img_x, img_y))
+          {
+            display->draw_pixel_at(x + img_x, y + img_y, this->get_rgb565_pixel_(img_x, img_y));
+          }
+        }
+      }
+    }
+  }
+
+  namespace animation
+  {
+    Animation::Animation(const uint8_t *data_start, int width, int height, uint32_t animation_frame_count,
+                         image::ImageType type)
+        : Image(data_start, width, height, type), animation_data_start_(data_start), current_frame_(0),
+          animation_frame_count_(animation_frame_count) {}
+
+    void Animation::next_frame()
+    {
+      this->current_frame_++;
+      if (this->current_frame_ >= (int)this->animation_frame_count_)
+        this->current_frame_ = 0;
+      this->update_data_start_();
+    }
+
+    void Animation::prev_frame()
+    {
+      this->current_frame_--;
+      if (this->current_frame_ < 0)
+        this->current_frame_ = this->animation_frame_count_ - 1;
+      this->update_data_start_();
+    }
+
+    void Animation::set_frame(int frame)
+    {
+      unsigned abs_frame = abs(frame);
+      if (abs_frame < this->animation_frame_count_)
+      {
+        this->current_frame_ = (frame >= 0) ? frame : this->animation_frame_count_ - abs_frame;
+        this->update_data_start_();
+      }
+    }
+
+    void Animation::update_data_start_()
+    {
+      const uint32_t image_size = this->width_ * this->height_ * 2;
+      this->data_start_ = this->animation_data_start_ + image_size * this->current_frame_;
+    }
+  }
+
+  namespace font
+  {
+    bool Glyph::get_pixel(int x, int y) const
+    {
+      const int x_data = x - this->glyph_data_->offset_x;
+      const int y_data = y - this->glyph_data_->offset_y;
+      if (x_data < 0 || x_data >= this->glyph_data_->width || y_data < 0 || y_data >= this->glyph_data_->height)
+        return false;
+      const uint32_t width_8 = ((this->glyph_data_->width + 7u) / 8u) * 8u;
+      const uint32_t pos = x_data + y_data * width_8;
+      return progmem_read_byte(this->glyph_data_->data + (pos / 8u)) & (0x80 >> (pos % 8u));
+    }
+
+    bool Glyph::compare_to(const uint8_t *str) const
+    {
+      for (uint32_t i = 0;; i++)
+      {
+        if (this->glyph_data_->a_char[i] == '\0')
+          return true;
+        if (str[i] == '\0')
+          return false;
+        if (this->glyph_data_->a_char[i] > str[i])
+          return false;
+        if (this->glyph_data_->a_char[i] < str[i])
+          return true;
+      }
+    }
+
+    int Glyph::match_length(const uint8_t *str) const
+    {
+      for (uint32_t i = 0;; i++)
+      {
+        if (this->glyph_data_->a_char[i] == '\0')
+          return i;
+        if (str[i] != this->glyph_data_->a_char[i])
+          return 0;
+      }
+    }
+
+    void Glyph::scan_area(int *x1, int *y1, int *width, int *height) const
+    {
+      *x1 = this->glyph_data_->offset_x;
+      *y1 = this->glyph_data_->offset_y;
+      *width = this->glyph_data_->width;
+      *height = this->glyph_data_->height;
+    }
+
+    Font::Font(const GlyphData *data, int data_nr, int baseline, int height) : baseline_(baseline), height_(height)
+    {
+      this->glyphs_.reserve(data_nr);
+      for (int i = 0; i < data_nr; ++i)
+        this->glyphs_.emplace_back(&data[i]);
+    }
+
+    int Font::match_next_glyph(const char *str, int *match_length)
+    {
+      int lo = 0;
+      int hi = this->glyphs_.size() - 1;
+      while (lo != hi)
+      {
+        int mid = (lo + hi + 1) / 2;
+        if (this->glyphs_[mid].compare_to((const uint8_t *)str))
+        {
+          lo = mid;
+        }
+        else
+        {
+          hi = mid - 1;
+        }
+      }
+      *match_length = this->glyphs_[lo].match_length((const uint8_t *)str);
+      if (*match_length <= 0)
+        return -1;
+      return lo;
+    }
+
+    void Font::measure(const char *str, int *width, int *x_offset, int *baseline, int *height)
+    {
+      *baseline = this->baseline_;
+      *height = this->height_;
+      int i = 0;
+      int min_x = 0;
+      bool has_char = false;
+      int x = 0;
+      while (str[i] != '\0')
+      {
+        int match_length;
+        int glyph_n = this->match_next_glyph(str + i, &match_length);
+        if (glyph_n < 0)
+        {
+          // Unknown char, skip
+          if (!this->get_glyphs().empty())
+            x += this->get_glyphs()[0].glyph_data_->width;
+          i++;
+          continue;
+        }
+
+        const Glyph &glyph = this->glyphs_[glyph_n];
+        if (!has_char)
+        {
+          min_x = glyph.glyph_data_->offset_x;
+        }
+        else
+        {
+          min_x = std::min(min_x, x + glyph.glyph_data_->offset_x);
+        }
+        x += glyph.glyph_data_->width + glyph.glyph_data_->offset_x;
+
+        i += match_length;
+        has_char = true;
+      }
+      *x_offset = min_x;
+      *width = x - min_x;
+    }
+
+    void Font::print(int x_start, int y_start, display::DisplayBuffer *display, Color color, const char *text)
+    {
+      int i = 0;
+      int x_at = x_start;
+      while (text[i] != '\0')
+      {
+        int match_length;
+        int glyph_n = this->match_next_glyph(text + i, &match_length);
+        if (glyph_n < 0)
+        {
+          // Unknown char, skip
+          if (!this->get_glyphs().empty())
+          {
+            uint8_t glyph_width = this->get_glyphs()[0].glyph_data_->width;
+            display->filled_rectangle(x_at, y_start, glyph_width, this->height_, color);
+            x_at += glyph_width;
+          }
+
+          i++;
+          continue;
+        }
+
+        const Glyph &glyph = this->get_glyphs()[glyph_n];
+        int scan_x1, scan_y1, scan_width, scan_height;
+        glyph.scan_area(&scan_x1, &scan_y1, &scan_width, &scan_height);
+
+        for (int glyph_x = scan_x1; glyph_x < scan_x1 + scan_width; glyph_x++)
+        {
+          for (int glyph_y = scan_y1; glyph_y < scan_y1 + scan_height; glyph_y++)
+          {
+            if (glyph.get_pixel(glyph_x, glyph_y))
+            {
+              display->draw_pixel_at(glyph_x + x_at, glyph_y + y_start, color);
+            }
+          }
+        }
+
+        x_at += glyph.glyph_data_->width + glyph.glyph_data_->offset_x;
+
+        i += match_length;
+      }
+    }
+  }
+}
@@ -0,0 +1,506 @@
+#pragma once
+// Lightweight stand-ins for the parts of the ESPHome API (2023.7) used by the
+// ehmtxv2 component, just enough to compile and run it on a Linux host.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#define PROGMEM
+
+// the levels and the esph_log_* layer of esphome/core/log.h, all of them are compiled in
+#define ESPHOME_LOG_LEVEL_NONE 0
+#define ESPHOME_LOG_LEVEL_ERROR 1
+#define ESPHOME_LOG_LEVEL_WARN 2
+#define ESPHOME_LOG_LEVEL_INFO 3
+#define ESPHOME_LOG_LEVEL_CONFIG 4
+#define ESPHOME_LOG_LEVEL_DEBUG 5
+#define ESPHOME_LOG_LEVEL_VERBOSE 6
+#define ESPHOME_LOG_LEVEL_VERY_VERBOSE 7
+#define ESPHOME_LOG_LEVEL ESPHOME_LOG_LEVEL_VERY_VERBOSE
+
+#define esph_log_e(tag, ...) esphome::sim::log(1, tag, __VA_ARGS__)
+#define esph_log_w(tag, ...) esphome::sim::log(2, tag, __VA_ARGS__)
+#define esph_log_i(tag, ...) esphome::sim::log(3, tag, __VA_ARGS__)
+#define esph_log_config(tag, ...) esphome::sim::log(3, tag, __VA_ARGS__)
+#define esph_log_d(tag, ...) esphome::sim::log(4, tag, __VA_ARGS__)
+#define esph_log_v(tag, ...) esphome::sim::log(5, tag, __VA_ARGS__)
+
+#define ESP_LOGE(tag, ...) esph_log_e(tag, __VA_ARGS__)
+#define ESP_LOGW(tag, ...) esph_log_w(tag, __VA_ARGS__)
+#define ESP_LOGI(tag, ...) esph_log_i(tag, __VA_ARGS__)
+#define ESP_LOGCONFIG(tag, ...) esph_log_config(tag, __VA_ARGS__)
+#define ESP_LOGD(tag, ...) esph_log_d(tag, __VA_ARGS__)
+#define ESP_LOGV(tag, ...) esph_log_v(tag, __VA_ARGS__)
+
+
+namespace esphome
+{
+  namespace sim
+  {
+    extern uint64_t now_us;   // virtual clock
+    extern int log_level;     // 0 = silent ... 5 = verbose
+    void log(int level, const char *tag, const char *format, ...) __attribute__((format(printf, 3, 4)));
+  }
+
+  inline uint32_t millis() { return (uint32_t)(sim::now_us / 1000); }
+  inline uint32_t micros() { return (uint32_t)sim::now_us; }
+  inline uint8_t progmem_read_byte(const uint8_t *addr) { return *addr; }
+  inline uint16_t progmem_read_uint16(const uint16_t *addr) { return *addr; }
+
+  void hsv_to_rgb(int hue, float saturation, float value, float &red, float &green, float &blue);
+  inline float lerp(float completion, float start, float end) { return start + (end - start) * completion; }
+
+  struct Color
+  {
+    union
+    {
+      struct
+      {
+        union
+        {
+          uint8_t r;
+          uint8_t red;
+        };
+        union
+        {
+          uint8_t g;
+          uint8_t green;
+        };
+        union
+        {
+          uint8_t b;
+          uint8_t blue;
+        };
+        union
+        {
+          uint8_t w;
+          uint8_t white;
+        };
+      };
+      uint8_t raw[4];
+      uint32_t raw_32;
+    };
+    Color() : raw_32(0) {}
+    Color(uint8_t red, uint8_t green, uint8_t blue) : r(red), g(green), b(blue), w(0) {}
+    Color(uint8_t red, uint8_t green, uint8_t blue, uint8_t white) : r(red), g(green), b(blue), w(white) {}
+    bool operator==(const Color &rhs) const { return this->raw_32 == rhs.raw_32; }
+    bool operator!=(const Color &rhs) const { return this->raw_32 != rhs.raw_32; }
+    uint8_t &operator[](size_t idx) { return this->raw[idx]; }
+    const uint8_t &operator[](size_t idx) const { return this->raw[idx]; }
+  };
+
+  namespace setup_priority
+  {
+    const float LATE = -100.0f;
+  }
+
+  class Component
+  {
+  public:
+    virtual ~Component() = default;
+    virtual void setup() {}
+    virtual void loop() {}
+    virtual void dump_config() {}
+    virtual void on_safe_shutdown() {}
+    virtual float get_setup_priority() const { return 0.0f; }
+  };
+
+  uint32_t fnv1_hash(const std::string &str);
+
+  // preferences in a map, sim::load_preferences() and sim::save_preferences() keep them in a file between runs
+  class ESPPreferenceObject
+  {
+  public:
+    ESPPreferenceObject() = default;
+    explicit ESPPreferenceObject(std::vector<uint8_t> *data) : data_(data) {}
+
+    template <typename T>
+    bool save(const T *src)
+    {
+      if (this->data_ == nullptr)
+        return false;
+      this->data_->assign((const uint8_t *)src, (const uint8_t *)src + sizeof(T));
+      return true;
+    }
+    template <typename T>
+    bool load(T *dest)
+    {
+      if ((this->data_ == nullptr) || (this->data_->size() != sizeof(T)))
+        return false;
+      memcpy(dest, this->data_->data(), sizeof(T));
+      return true;
+    }
+
+  protected:
+    std::vector<uint8_t> *data_ = nullptr;
+  };
+
+  class ESPPreferences
+  {
+  public:
+    template <typename T>
+    ESPPreferenceObject make_preference(uint32_t type, bool in_flash)
+    {
+      return ESPPreferenceObject(&this->data[type]);
+    }
+    bool sync() { return true; }
+
+    std::map<uint32_t, std::vector<uint8_t>> data;
+  };
+
+  extern ESPPreferences *global_preferences;
+
+  namespace sim
+  {
+    bool load_preferences(const char *path);
+    bool save_preferences(const char *path);
+  }
+
+  class PollingComponent : public Component
+  {
+  public:
+    PollingComponent() : PollingComponent(0) {}
+    explicit PollingComponent(uint32_t update_interval) : update_interval_(update_interval) {}
+    virtual void update() = 0;
+    uint32_t get_update_interval() const { return this->update_interval_; }
+    void set_update_interval(uint32_t update_interval) { this->update_interval_ = update_interval; }
+
+  protected:
+    uint32_t update_interval_;
+  };
+
+  template <typename... Ts>
+  class Trigger
+  {
+  public:
+    void trigger(Ts... x)
+    {
+      for (auto &cb : this->callbacks_)
+        cb(x...);
+    }
+    void add_callback(std::function<void(Ts...)> &&cb) { this->callbacks_.push_back(std::move(cb)); }
+
+  protected:
+    std::vector<std::function<void(Ts...)>> callbacks_;
+  };
+
+  struct ESPTime
+  {
+    uint8_t second;
+    uint8_t minute;
+    uint8_t hour;
+    uint8_t day_of_week; // 1 = sunday
+    uint8_t day_of_month;
+    uint16_t day_of_year;
+    uint8_t month;
+    uint16_t year;
+    bool is_dst;
+    time_t timestamp;
+
+    size_t strftime(char *buffer, size_t buffer_len, const char *format);
+    bool is_valid() const { return this->year >= 2019; }
+    static ESPTime from_epoch_local(time_t epoch);
+  };
+
+  namespace time
+  {
+    using esphome::ESPTime;
+
+    class RealTimeClock : public PollingComponent
+    {
+    public:
+      ESPTime now();
+      void update() override {}
+
+      bool synced = true;          // false emulates a clock without RTC before SNTP/HA sync
+      time_t epoch_offset = 1690000000;
+    };
+  }
+
+  namespace image
+  {
+    enum ImageType
+    {
+      IMAGE_TYPE_BINARY = 0,
+      IMAGE_TYPE_GRAYSCALE = 1,
+      IMAGE_TYPE_RGB24 = 2,
+      IMAGE_TYPE_TRANSPARENT_BINARY = 3,
+      IMAGE_TYPE_RGB565 = 4,
+    };
+  }
+
+  namespace display
+  {
+    enum class TextAlign
+    {
+      TOP = 0x00,
+      CENTER_VERTICAL = 0x01,
+      BASELINE = 0x02,
+      BOTTOM = 0x04,
+
+      LEFT = 0x00,
+      CENTER_HORIZONTAL = 0x08,
+      RIGHT = 0x10,
+
+      TOP_LEFT = TOP | LEFT,
+      TOP_CENTER = TOP | CENTER_HORIZONTAL,
+      TOP_RIGHT = TOP | RIGHT,
+
+      CENTER_LEFT = CENTER_VERTICAL | LEFT,
+      CENTER = CENTER_VERTICAL | CENTER_HORIZONTAL,
+      CENTER_RIGHT = CENTER_VERTICAL | RIGHT,
+
+      BASELINE_LEFT = BASELINE | LEFT,
+      BASELINE_CENTER = BASELINE | CENTER_HORIZONTAL,
+      BASELINE_RIGHT = BASELINE | RIGHT,
+
+      BOTTOM_LEFT = BOTTOM | LEFT,
+      BOTTOM_CENTER = BOTTOM | CENTER_HORIZONTAL,
+      BOTTOM_RIGHT = BOTTOM | RIGHT,
+    };
+
+    extern const Color COLOR_OFF;
+    extern const Color COLOR_ON;
+
+    enum DisplayType
+    {
+      DISPLAY_TYPE_BINARY = 1,
+      DISPLAY_TYPE_GRAYSCALE = 2,
+      DISPLAY_TYPE_COLOR = 3,
+    };
+
+    class DisplayBuffer;
+
+    class BaseFont
+    {
+    public:
+      virtual ~BaseFont() = default;
+      virtual void print(int x, int y, DisplayBuffer *display, Color color, const char *text) = 0;
+      virtual void measure(const char *str, int *width, int *x_offset, int *baseline, int *height) = 0;
+    };
+
+    class BaseImage
+    {
+    public:
+      virtual ~BaseImage() = default;
+      virtual void draw(int x, int y, DisplayBuffer *display, Color color_on, Color color_off) = 0;
+    };
+
+    class DisplayBuffer : public PollingComponent
+    {
+    public:
+      void update() override {}
+
+      void draw_pixel_at(int x, int y, Color color);
+      void line(int x1, int y1, int x2, int y2, Color color = COLOR_ON);
+      void horizontal_line(int x, int y, int width, Color color = COLOR_ON);
+      void vertical_line(int x, int y, int height, Color color = COLOR_ON);
+      void rectangle(int x1, int y1, int width, int height, Color color = COLOR_ON);
+      void filled_rectangle(int x1, int y1, int width, int height, Color color = COLOR_ON);
+      void print(int x, int y, BaseFont *font, Color color, TextAlign align, const char *text);
+      void print(int x, int y, BaseFont *font, Color color, const char *text);
+      void strftime(int x, int y, BaseFont *font, Color color, TextAlign align, const char *format, ESPTime time);
+      void image(int x, int y, BaseImage *image, Color color_on = COLOR_ON, Color color_off = COLOR_OFF);
+      void get_text_bounds(int x, int y, const char *text, BaseFont *font, TextAlign align, int *x1, int *y1, int *width,
+                           int *height);
+      int get_width() { return this->get_width_internal(); }
+      int get_height() { return this->get_height_internal(); }
+      virtual DisplayType get_display_type() = 0;
+
+    protected:
+      virtual void draw_absolute_pixel_internal(int x, int y, Color color) = 0;
+      virtual int get_width_internal() = 0;
+      virtual int get_height_internal() = 0;
+    };
+  }
+
+  namespace image
+  {
+    class Image : public display::BaseImage
+    {
+    public:
+      Image(const uint8_t *data_start, int width, int height, ImageType type)
+          : width_(width), height_(height), type_(type), data_start_(data_start) {}
+      void draw(int x, int y, display::DisplayBuffer *display, Color color_on, Color color_off) override;
+      Color get_pixel(int x, int y, Color color_on = display::COLOR_ON, Color color_off = display::COLOR_OFF) const;
+      int get_width() const { return this->width_; }
+      int get_height() const { return this->height_; }
+      ImageType get_type() const { return this->type_; }
+      void set_transparency(bool transparent) { this->transparent_ = transparent; }
+      bool has_transparency() const { return this->transparent_; }
+
+    protected:
+      Color get_rgb565_pixel_(int x, int y) const;
+      bool is_transparent_(int x, int y) const;
+
+      int width_;
+      int height_;
+      ImageType type_;
+      const uint8_t *data_start_;
+      bool transparent_ = false;
+    };
+  }
+
+  namespace animation
+  {
+    class Animation : public image::Image
+    {
+    public:
+      Animation(const uint8_t *data_start, int width, int height, uint32_t animation_frame_count, image::ImageType type);
+      uint32_t get_animation_frame_count() const { return this->animation_frame_count_; }
+      int get_current_frame() const { return this->current_frame_; }
+      void next_frame();
+      void prev_frame();
+      void set_frame(int frame);
+
+    protected:
+      void update_data_start_();
+
+      const uint8_t *animation_data_start_;
+      int current_frame_;
+      uint32_t animation_frame_count_;
+    };
+  }
+
+  namespace font
+  {
+    class Font;
+
+    struct GlyphData
+    {
+      const uint8_t *a_char;
+      const uint8_t *data;
+      int offset_x;
+      int offset_y;
+      int width;
+      int height;
+    };
+
+    class Glyph
+    {
+    public:
+      Glyph(const GlyphData *data) : glyph_data_(data) {}
+      bool get_pixel(int x, int y) const;
+      const uint8_t *get_char() const { return this->glyph_data_->a_char; }
+      bool compare_to(const uint8_t *str) const;
+      int match_length(const uint8_t *str) const;
+      void scan_area(int *x1, int *y1, int *width, int *height) const;
+
+    protected:
+      friend Font;
+      const GlyphData *glyph_data_;
+    };
+
+    class Font : public display::BaseFont
+    {
+    public:
+      Font(const GlyphData *data, int data_nr, int baseline, int height);
+      int match_next_glyph(const char *str, int *match_length);
+      void print(int x_start, int y_start, display::DisplayBuffer *display, Color color, const char *text) override;
+      void measure(const char *str, int *width, int *x_offset, int *baseline, int *height) override;
+      int get_baseline() { return this->baseline_; }
+      int get_height() { return this->height_; }
+      const std::vector<Glyph> &get_glyphs() const { return this->glyphs_; }
+
+    protected:
+      std::vector<Glyph> glyphs_;
+      int baseline_;
+      int height_;
+    };
+  }
+
+  namespace light
+  {
+    class AddressableLight
+    {
+    public:
+      void set_correction(float red, float green, float blue, float white = 1.0f)
+      {
+        this->correction[0] = red;
+        this->correction[1] = green;
+        this->correction[2] = blue;
+        this->correction[3] = white;
+      }
+      float correction[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    };
+  }
+
+  namespace addressable_light
+  {
+    // emulated matrix, the frame is kept as plain RGB for dumping
+    class AddressableLightDisplay : public display::DisplayBuffer
+    {
+    public:
+      AddressableLightDisplay(int width, int height) : width_(width), height_(height), buffer_(width * height) {}
+      light::AddressableLight *get_light() { return &this->light_; }
+      void clear() { std::fill(this->buffer_.begin(), this->buffer_.end(), Color()); }
+      Color get_pixel(int x, int y) const { return this->buffer_[x + y * this->width_]; }
+      display::DisplayType get_display_type() override { return display::DisplayType::DISPLAY_TYPE_COLOR; }
+      uint32_t pixel_writes = 0;
+
+    protected:
+      void draw_absolute_pixel_internal(int x, int y, Color color) override
+      {
+        this->pixel_writes++;
+        this->buffer_[x + y * this->width_] = color;
+      }
+      int get_width_internal() override { return this->width_; }
+      int get_height_internal() override { return this->height_; }
+
+      int width_;
+      int height_;
+      std::vector<Color> buffer_;
+      light::AddressableLight light_;
+    };
+  }
+
+  namespace sensor
+  {
+    class Sensor
+    {
+    public:
+      float state = NAN;
+      uint32_t publishes = 0;
+
+      void publish_state(float state)
+      {
+        this->state = state;
+        this->publishes++;
+      }
+    };
+  }
+
+  namespace api
+  {
+    class CustomAPIDevice
+    {
+    public:
+      template <typename T, typename... Ts>
+      void register_service(void (T::*callback)(Ts...), const std::string &name,
+                            const std::array<std::string, sizeof...(Ts)> &arg_names)
+      {
+        this->services_.push_back(name);
+      }
+      template <typename T>
+      void register_service(void (T::*callback)(), const std::string &name)
+      {
+        this->services_.push_back(name);
+      }
+      const std::vector<std::string> &get_services() const { return this->services_; }
+
+    protected:
+      std::vector<std::string> services_;
+    };
+  }
+}
@@ -0,0 +1,125 @@
+#include "esphome.h"
+#include "sim_font.h"
+
+// 3x5 pixel font with a few UTF-8 glyphs, laid out like the data the esphome
+// font codegen emits: glyphs sorted by their UTF-8 bytes, 1bpp rows padded to 8 bit
+
+namespace esphome
+{
+  namespace sim
+  {
+    struct SimGlyph
+    {
+      const char *chr;
+      const char *rows[5];
+    };
+
+    static const SimGlyph SIM_GLYPHS[] = {
+        {" ", {"...", "...", "...", "...", "..."}},
+        {"!", {".#.", ".#.", ".#.", "...", ".#."}},
+        {"%", {"#.#", "..#", ".#.", "#..", "#.#"}},
+        {"+", {"...", ".#.", "###", ".#.", "..."}},
+        {",", {"...", "...", "...", ".#.", "#.."}},
+        {"-", {"...", "...", "###", "...", "..."}},
+        {".", {"...", "...", "...", "...", ".#."}},
+        {"/", {"..#", "..#", ".#.", "#..", "#.."}},
+        {"0", {"###", "#.#", "#.#", "#.#", "###"}},
+        {"1", {".#.", "##.", ".#.", ".#.", "###"}},
+        {"2", {"###", "..#", "###", "#..", "###"}},
+        {"3", {"###", "..#", ".##", "..#", "###"}},
+        {"4", {"#.#", "#.#", "###", "..#", "..#"}},
+        {"5", {"###", "#..", "###", "..#", "###"}},
+        {"6", {"###", "#..", "###", "#.#", "###"}},
+        {"7", {"###", "..#", ".#.", ".#.", ".#."}},
+        {"8", {"###", "#.#", "###", "#.#", "###"}},
+        {"9", {"###", "#.#", "###", "..#", "###"}},
+        {":", {"...", ".#.", "...", ".#.", "..."}},
+        {"?", {"###", "..#", ".##", "...", ".#."}},
+        {"A", {".#.", "#.#", "###", "#.#", "#.#"}},
+        {"B", {"##.", "#.#", "##.", "#.#", "##."}},
+        {"C", {".##", "#..", "#..", "#..", ".##"}},
+        {"D", {"##.", "#.#", "#.#", "#.#", "##."}},
+        {"E", {"###", "#..", "##.", "#..", "###"}},
+        {"F", {"###", "#..", "##.", "#..", "#.."}},
+        {"G", {".##", "#..", "#.#", "#.#", ".##"}},
+        {"H", {"#.#", "#.#", "###", "#.#", "#.#"}},
+        {"I", {"###", ".#.", ".#.", ".#.", "###"}},
+        {"J", {"..#", "..#", "..#", "#.#", ".#."}},
+        {"K", {"#.#", "#.#", "##.", "#.#", "#.#"}},
+        {"L", {"#..", "#..", "#..", "#..", "###"}},
+        {"M", {"#.#", "###", "###", "#.#", "#.#"}},
+        {"N", {"##.", "#.#", "#.#", "#.#", "#.#"}},
+        {"O", {".#.", "#.#", "#.#", "#.#", ".#."}},
+        {"P", {"##.", "#.#", "##.", "#..", "#.."}},
+        {"Q", {".#.", "#.#", "#.#", "##.", ".##"}},
+        {"R", {"##.", "#.#", "##.", "#.#", "#.#"}},
+        {"S", {".##", "#..", ".#.", "..#", "##."}},
+        {"T", {"###", ".#.", ".#.", ".#.", ".#."}},
+        {"U", {"#.#", "#.#", "#.#", "#.#", "###"}},
+        {"V", {"#.#", "#.#", "#.#", "#.#", ".#."}},
+        {"W", {"#.#", "#.#", "###", "###", "#.#"}},
+        {"X", {"#.#", "#.#", ".#.", "#.#", "#.#"}},
+        {"Y", {"#.#", "#.#", ".#.", ".#.", ".#."}},
+        {"Z", {"###", "..#", ".#.", "#..", "###"}},
+        {"a", {"...", ".##", "#.#", "#.#", ".##"}},
+        {"b", {"#..", "##.", "#.#", "#.#", "##."}},
+        {"c", {"...", ".##", "#..", "#..", ".##"}},
+        {"d", {"..#", ".##", "#.#", "#.#", ".##"}},
+        {"e", {"...", ".#.", "###", "#..", ".##"}},
+        {"f", {"..#", ".#.", "###", ".#.", ".#."}},
+        {"g", {"...", ".##", "#.#", ".##", "##."}},
+        {"h", {"#..", "##.", "#.#", "#.#", "#.#"}},
+        {"i", {".#.", "...", ".#.", ".#.", ".#."}},
+        {"j", {"..#", "...", "..#", "#.#", ".#."}},
+        {"k", {"#..", "#.#", "##.", "##.", "#.#"}},
+        {"l", {"##.", ".#.", ".#.", ".#.", "###"}},
+        {"m", {"...", "###", "###", "#.#", "#.#"}},
+        {"n", {"...", "##.", "#.#", "#.#", "#.#"}},
+        {"o", {"...", ".#.", "#.#", "#.#", ".#."}},
+        {"p", {"...", "##.", "#.#", "##.", "#.."}},
+        {"q", {"...", ".##", "#.#", ".##", "..#"}},
+        {"r", {"...", ".##", "#..", "#..", "#.."}},
+        {"s", {"...", ".##", "##.", "..#", "##."}},
+        {"t", {".#.", "###", ".#.", ".#.", "..#"}},
+        {"u", {"...", "#.#", "#.#", "#.#", ".##"}},
+        {"v", {"...", "#.#", "#.#", "#.#", ".#."}},
+        {"w", {"...", "#.#", "#.#", "###", "###"}},
+        {"x", {"...", "#.#", ".#.", ".#.", "#.#"}},
+        {"y", {"...", "#.#", "#.#", ".##", "##."}},
+        {"z", {"...", "###", ".##", "##.", "###"}},
+        {"°", {".#.", "#.#", ".#.", "...", "..."}}, // °
+        {"Ä", {"#.#", ".#.", "#.#", "###", "#.#"}}, // Ä
+        {"Ö", {"#.#", ".#.", "#.#", "#.#", ".#."}}, // Ö
+        {"Ü", {"#.#", "...", "#.#", "#.#", "###"}}, // Ü
+        {"ß", {"##.", "#.#", "##.", "#.#", "##."}}, // ß
+        {"ä", {"#.#", ".##", "#.#", "#.#", ".##"}}, // ä
+        {"ö", {"#.#", ".#.", "#.#", "#.#", ".#."}}, // ö
+        {"ü", {"#.#", "...", "#.#", "#.#", ".##"}}, // ü
+        {"€", {".##", "##.", "#..", "##.", ".##"}}, // €
+    };
+    static const int SIM_GLYPH_COUNT = sizeof(SIM_GLYPHS) / sizeof(SIM_GLYPHS[0]);
+
+    static uint8_t sim_glyph_bitmaps[SIM_GLYPH_COUNT][5];
+    static font::GlyphData sim_glyph_data[SIM_GLYPH_COUNT];
+
+    font::Font *make_font()
+    {
+      for (int i = 0; i < SIM_GLYPH_COUNT; i++)
+      {
+        for (int y = 0; y < 5; y++)
+        {
+          uint8_t row = 0;
+          for (int x = 0; x < 3; x++)
+          {
+            if (SIM_GLYPHS[i].rows[y][x] == '#')
+              row |= 0x80 >> x;
+          }
+          sim_glyph_bitmaps[i][y] = row;
+        }
+        // one column bearing on the left, baseline at row 6 of an 8 pixel high font
+        sim_glyph_data[i] = {(const uint8_t *)SIM_GLYPHS[i].chr, sim_glyph_bitmaps[i], 1, 1, 3, 5};
+      }
+      return new font::Font(sim_glyph_data, SIM_GLYPH_COUNT, 6, 8);
+    }
+  }
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+namespace esphome
+{
+  namespace sim
+  {
+    font::Font *make_font();
+  }
+}
@@ -0,0 +1,107 @@
+#include "esphome.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// every task is a thread that runs in lockstep with the harness: step_tasks() lets each task run until it
+// waits in vTaskDelayUntil() and blocks meanwhile, so the virtual clock and the frames stay deterministic
+struct sim_task
+{
+  TaskFunction_t code;
+  void *parameters;
+  bool running = false;
+  bool finished = false;
+};
+
+namespace
+{
+  // never destroyed, the task threads are still blocked when the program exits
+  std::mutex &lock = *new std::mutex();
+  std::condition_variable &changed = *new std::condition_variable();
+  std::vector<sim_task *> &tasks = *new std::vector<sim_task *>();
+  thread_local sim_task *current = nullptr;
+
+  void wait_for_step(std::unique_lock<std::mutex> &guard)
+  {
+    current->running = false;
+    changed.notify_all();
+    changed.wait(guard, []()
+                 { return current->running; });
+  }
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char *name, uint32_t stack_depth, void *parameters,
+                                   UBaseType_t priority, TaskHandle_t *created_task, BaseType_t core_id)
+{
+  sim_task *task = new sim_task{code, parameters};
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    tasks.push_back(task);
+  }
+  if (created_task != nullptr)
+  {
+    *created_task = task;
+  }
+  std::thread([task]()
+              {
+                current = task;
+                {
+                  std::unique_lock<std::mutex> guard(lock);
+                  changed.wait(guard, [task]() { return task->running; });
+                }
+                task->code(task->parameters);
+                std::lock_guard<std::mutex> guard(lock);
+                task->running = false;
+                task->finished = true;
+                changed.notify_all(); })
+      .detach();
+  return pdPASS;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+  return current;
+}
+
+TickType_t xTaskGetTickCount()
+{
+  return esphome::millis();
+}
+
+// the harness owns the virtual clock, the task just waits for the next step
+void vTaskDelayUntil(TickType_t *previous_wake_time, TickType_t time_increment)
+{
+  *previous_wake_time += time_increment;
+  std::unique_lock<std::mutex> guard(lock);
+  wait_for_step(guard);
+}
+
+BaseType_t xPortGetCoreID()
+{
+  return current == nullptr ? 1 : 0;
+}
+
+namespace esphome
+{
+  namespace sim
+  {
+    void step_tasks()
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      for (sim_task *task : tasks)
+      {
+        if (task->finished)
+        {
+          continue;
+        }
+        task->running = true;
+        changed.notify_all();
+        changed.wait(guard, [task]()
+                     { return !task->running; });
+      }
+    }
+  }
+}
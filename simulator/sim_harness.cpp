@@ -0,0 +1,147 @@
+#include "esphome.h"
+#include "sim_font.h"
+#include "sim_harness.h"
+
+#include <chrono>
+
+namespace esphome
+{
+  namespace sim
+  {
+    Harness::Harness(int width, int height)
+    {
+      this->display = new addressable_light::AddressableLightDisplay(width, height);
+      this->display->set_update_interval(this->frame_interval_ms);
+      this->clock = new time::RealTimeClock();
+      this->font = make_font();
+      this->ehmtx = new EHMTX();
+      this->ehmtx->set_display(this->display);
+      this->ehmtx->set_clock(this->clock);
+      this->ehmtx->set_default_font(this->font);
+      this->ehmtx->set_special_font(this->font);
+      this->ehmtx->set_brightness(80);
+      this->ehmtx->set_show_day_of_week(true);
+      this->ehmtx->set_show_date(true);
+      this->ehmtx->set_show_seconds(false);
+    }
+
+    void Harness::setup()
+    {
+      this->ehmtx->setup();
+      this->ehmtx->dump_config();
+      this->next_frame_us_ = now_us;
+      this->next_update_us_ = now_us;
+    }
+
+    // one display update with auto_clear_enabled: true and the lambda from the sample YAML
+    void Harness::frame()
+    {
+      this->display->clear();
+      auto start = std::chrono::steady_clock::now();
+#ifdef EHMTXv2_RENDER_TASK
+      step_tasks(); // the render task draws the frame that draw() shows
+#endif
+      this->ehmtx->tick();
+      this->ehmtx->draw();
+      this->frame_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+      this->frames++;
+      this->ehmtx->loop(); // the main loop after the display update, dispatches the triggers
+    }
+
+    void Harness::run_for(uint32_t ms, const std::function<void()> &on_frame)
+    {
+      uint64_t end_us = now_us + (uint64_t)ms * 1000;
+      while (true)
+      {
+        uint64_t next = std::min(this->next_frame_us_, this->next_update_us_);
+        if (next > end_us)
+          break;
+        now_us = next;
+        if (now_us == this->next_update_us_)
+        {
+          this->ehmtx->update();
+          this->next_update_us_ += (uint64_t)this->ehmtx->get_update_interval() * 1000;
+        }
+        if (now_us == this->next_frame_us_)
+        {
+          this->frame();
+          if (on_frame)
+            on_frame();
+          this->next_frame_us_ += (uint64_t)this->frame_interval_ms * 1000;
+        }
+      }
+      now_us = end_us;
+    }
+
+    static uint16_t rgb565(uint8_t r, uint8_t g, uint8_t b)
+    {
+      return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+    }
+
+    static const uint8_t *make_icon_data(int width, int height, int frames, int seed)
+    {
+      uint8_t *data = new uint8_t[width * height * 2 * frames];
+      uint8_t *p = data;
+      for (int f = 0; f < frames; f++)
+      {
+        for (int y = 0; y < height; y++)
+        {
+          for (int x = 0; x < width; x++)
+          {
+            bool on = ((x + y + f + seed) % 4) == 0;
+            uint16_t c = on ? rgb565(255 - seed * 2, 200, (seed * 40) & 255) : rgb565(0, 0, 40);
+            *p++ = c >> 8;
+            *p++ = c & 255;
+          }
+        }
+      }
+      return data;
+    }
+
+    // "sun" and "wide" like in the samples, filled up with icon<n> up to count icons
+    void add_icons(EHMTX *ehmtx, int count)
+    {
+      ehmtx->add_icon(new EHMTX_Icon(make_icon_data(8, 8, 4, 0), 8, 8, 4, image::IMAGE_TYPE_RGB565, "sun", false, 100));
+      ehmtx->add_icon(new EHMTX_Icon(make_icon_data(32, 8, 3, 1), 32, 8, 3, image::IMAGE_TYPE_RGB565, "wide", true, 150));
+      for (int i = 2; i < count; i++)
+      {
+        ehmtx->add_icon(new EHMTX_Icon(make_icon_data(8, 8, 1, i), 8, 8, 1, image::IMAGE_TYPE_RGB565,
+                                       "icon" + std::to_string(i), false, 192));
+      }
+    }
+
+    void dump_ansi(FILE *out, addressable_light::AddressableLightDisplay *display)
+    {
+      for (int y = 0; y < display->get_height(); y++)
+      {
+        for (int x = 0; x < display->get_width(); x++)
+        {
+          Color c = display->get_pixel(x, y);
+          fprintf(out, "\x1b[48;2;%d;%d;%dm  ", c.r, c.g, c.b);
+        }
+        fprintf(out, "\x1b[0m\n");
+      }
+    }
+
+    bool write_ppm(const char *path, addressable_light::AddressableLightDisplay *display, int scale)
+    {
+      FILE *f = fopen(path, "wb");
+      if (f == nullptr)
+        return false;
+      int width = display->get_width() * scale;
+      int height = display->get_height() * scale;
+      fprintf(f, "P6\n%d %d\n255\n", width, height);
+      for (int y = 0; y < height; y++)
+      {
+        for (int x = 0; x < width; x++)
+        {
+          Color c = display->get_pixel(x / scale, y / scale);
+          uint8_t rgb[3] = {c.r, c.g, c.b};
+          fwrite(rgb, 1, 3, f);
+        }
+      }
+      fclose(f);
+      return true;
+    }
+  }
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <functional>
+
+namespace esphome
+{
+  namespace sim
+  {
+    // wires the component like the esphome YAML does and drives it on the virtual clock
+    class Harness
+    {
+    public:
+      Harness(int width = MATRIX_WIDTH, int height = MATRIX_HEIGHT);
+
+      addressable_light::AddressableLightDisplay *display;
+      time::RealTimeClock *clock;
+      font::Font *font;
+      EHMTX *ehmtx;
+
+      uint32_t frame_interval_ms = 16; // display update_interval, raise it to simulate slow frames
+      uint64_t frames = 0;
+      uint64_t frame_ns = 0; // host time of the last tick() and draw()
+
+      void setup();
+      void frame();
+      void run_for(uint32_t ms, const std::function<void()> &on_frame = nullptr);
+
+    protected:
+      uint64_t next_frame_us_ = 0;
+      uint64_t next_update_us_ = 0;
+    };
+
+    void add_icons(EHMTX *ehmtx, int count);
+
+    void dump_ansi(FILE *out, addressable_light::AddressableLightDisplay *display);
+    bool write_ppm(const char *path, addressable_light::AddressableLightDisplay *display, int scale);
+  }
+}
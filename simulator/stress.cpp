@@ -0,0 +1,121 @@
+#include "esphome.h"
+
+#include <chrono>
+#include <getopt.h>
+#include <string>
+#include <thread>
+
+using namespace esphome;
+
+// one producer and one consumer thread on a free running EHMTX_Ring, like the main loop and the render task,
+// the consumer checks that every item arrives once, in order and intact
+template <typename T, uint16_t N, typename Make, typename Check>
+static bool stress(const char *name, uint64_t count, Make make, Check check)
+{
+  EHMTX_Ring<T, N> *ring = new EHMTX_Ring<T, N>();
+  uint64_t full = 0;
+  uint64_t empty = 0;
+  uint64_t errors = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  std::thread producer([&]()
+                       {
+                         for (uint64_t i = 0; i < count; i++)
+                         {
+                           T item = make(i);
+                           while (!ring->push(std::move(item)))
+                           {
+                             full++;
+                             item = make(i);
+                             std::this_thread::yield();
+                           }
+                         } });
+  std::thread consumer([&]()
+                       {
+                         T item;
+                         for (uint64_t i = 0; i < count; i++)
+                         {
+                           while (!ring->pop(item))
+                           {
+                             empty++;
+                             std::this_thread::yield();
+                           }
+                           if (!check(i, item) && (errors++ < 5))
+                           {
+                             fprintf(stderr, "%s: item %llu wrong\n", name, (unsigned long long)i);
+                           }
+                         } });
+  producer.join();
+  consumer.join();
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+  bool ok = (errors == 0) && (ring->size() == 0);
+  printf("%-24s %10llu items %7.1f ns/item  full: %llu empty: %llu  %s\n", name, (unsigned long long)count,
+         (double)ns / count, (unsigned long long)full, (unsigned long long)empty, ok ? "OK" : "FAILED");
+  delete ring;
+  return ok;
+}
+
+static void usage(const char *name)
+{
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  -n, --items N    items per ring (default 1000000)\n"
+          "  -r, --rounds N   repeat N times (default 1)\n",
+          name);
+}
+
+int main(int argc, char **argv)
+{
+  uint64_t count = 1000000;
+  int rounds = 1;
+
+  static const struct option options[] = {
+      {"items", required_argument, nullptr, 'n'},
+      {"rounds", required_argument, nullptr, 'r'},
+      {"help", no_argument, nullptr, 'h'},
+      {nullptr, 0, nullptr, 0},
+  };
+  int c;
+  while ((c = getopt_long(argc, argv, "n:r:h", options, nullptr)) != -1)
+  {
+    switch (c)
+    {
+    case 'n':
+      count = strtoull(optarg, nullptr, 10);
+      break;
+    case 'r':
+      rounds = atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return c == 'h' ? 0 : 1;
+    }
+  }
+
+  bool ok = true;
+  for (int round = 0; round < rounds; round++)
+  {
+    ok &= stress<uint32_t, COMMAND_QUEUE>(
+        "sequence", count, [](uint64_t i)
+        { return (uint32_t)i; },
+        [](uint64_t i, uint32_t item)
+        { return item == (uint32_t)i; });
+    // the smallest ring wraps and fills all the time
+    ok &= stress<uint32_t, 2>(
+        "sequence, 2 slots", count, [](uint64_t i)
+        { return (uint32_t)i; },
+        [](uint64_t i, uint32_t item)
+        { return item == (uint32_t)i; });
+    // like post(), the captured string is on the heap and moved through the ring
+    ok &= stress<std::function<std::string()>, COMMAND_QUEUE>(
+        "commands", count, [](uint64_t i)
+        {
+          std::string text = "screen text number " + std::to_string(i);
+          return std::function<std::string()>([text]()
+                                              { return text; }); },
+        [](uint64_t i, const std::function<std::string()> &command)
+        { return command() == "screen text number " + std::to_string(i); });
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+"""icon_cache.py against icons served by http.server on localhost.
+
+    python3 -m unittest discover -s tests
+"""
+
+import os
+import sys
+import tempfile
+import threading
+import unittest
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "components", "ehmtxv2"))
+
+from icon_cache import IconCache, IconCacheError  # noqa: E402
+
+ICONS = {"/icons/1": b"GIF89a one", "/icons/2": b"GIF89a two", "/icons/3": b"GIF89a three"}
+
+
+class IconServer(ThreadingHTTPServer):
+    """serves ICONS, /flaky/<n> fails with 503 on the first request"""
+
+    def __init__(self):
+        super().__init__(("127.0.0.1", 0), IconHandler)
+        self.requests = {}
+        self.lock = threading.Lock()
+
+    def count(self, path):
+        with self.lock:
+            self.requests[path] = self.requests.get(path, 0) + 1
+            return self.requests[path]
+
+    def total(self):
+        with self.lock:
+            return sum(self.requests.values())
+
+
+class IconHandler(BaseHTTPRequestHandler):
+    def do_GET(self):
+        n = self.server.count(self.path)
+        if self.path.startswith("/flaky/") and n == 1:
+            self.send_error(503)
+            return
+        content = ICONS.get(self.path.replace("/flaky/", "/icons/"))
+        if content is None:
+            self.send_error(404)
+            return
+        self.send_response(200)
+        self.send_header("Content-Length", str(len(content)))
+        self.end_headers()
+        self.wfile.write(content)
+
+    def log_message(self, format, *args):
+        pass
+
+
+class IconCacheTest(unittest.TestCase):
+    def setUp(self):
+        self.server = IconServer()
+        self.thread = threading.Thread(target=self.server.serve_forever, daemon=True)
+        self.thread.start()
+        self.base = f"http://127.0.0.1:{self.server.server_address[1]}"
+        self.dir = tempfile.TemporaryDirectory()
+
+    def tearDown(self):
+        self.server.shutdown()
+        self.server.server_close()
+        self.dir.cleanup()
+
+    def cache(self, **kwargs):
+        return IconCache(self.dir.name, lameid_url=self.base + "/icons/", **kwargs)
+
+    def test_hit_skips_download(self):
+        urls = [self.cache().lameid_to_url(i) for i in (1, 2, 3)]
+        first = self.cache()
+        self.assertEqual(first.fetch_all(urls), {url: ICONS[url[len(self.base):]] for url in urls})
+        self.assertEqual((first.hits, first.downloads), (0, 3))
+        requests = self.server.total()
+
+        second = self.cache()
+        self.assertEqual(second.fetch_all(urls), first.fetch_all(urls))
+        self.assertEqual((second.hits, second.downloads), (3, 0))
+        self.assertEqual(self.server.total(), requests)
+
+    def test_retry_after_failure(self):
+        cache = self.cache()
+        url = self.base + "/flaky/1"
+        self.assertEqual(cache.fetch_all([url]), {url: ICONS["/icons/1"]})
+        self.assertEqual(self.server.requests["/flaky/1"], 2)
+        self.assertEqual(cache.downloads, 1)
+
+    def test_offline_fails_for_uncached(self):
+        cached = self.base + "/icons/1"
+        self.cache().fetch_all([cached])
+        requests = self.server.total()
+
+        offline = self.cache(offline=True)
+        self.assertEqual(offline.fetch_all([cached]), {cached: ICONS["/icons/1"]})
+        with self.assertRaises(IconCacheError):
+            offline.fetch_all([self.base + "/icons/2"])
+        self.assertEqual(self.server.total(), requests)
+
+
+if __name__ == "__main__":
+    unittest.main()